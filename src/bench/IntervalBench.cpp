@@ -0,0 +1,602 @@
+// Microbenchmarks for the Interval lattice operations.
+//
+// Compares the bit-set operations in Interval.h with the switch statements
+// that Constraint used before, kept below as a reference. Before timing, every
+// pair of intervals is checked to give the same result with both, and
+// IntervalVector is checked against joining and meeting lane by lane.
+//
+// Usage: interval-bench [iterations]
+
+#include "Interval.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// ---- Reference implementation (switch statements) ----
+
+bool switchCovers(Interval interval, Interval other) {
+  if (interval == other) {
+    return true;
+  }
+  if (interval == Interval::TOP) {
+    return true;
+  }
+  if (other == Interval::TOP) {
+    return false;
+  }
+  if (interval == Interval::BOT) {
+    return false;
+  }
+  if (other == Interval::BOT) {
+    return true;
+  }
+  if (interval == Interval::LTZ) {
+    return false;
+  }
+  if (interval == Interval::ZERO) {
+    return false;
+  }
+  if (interval == Interval::GTZ) {
+    return false;
+  }
+
+  switch (interval) {
+  case Interval::LEZ:
+    switch (other) {
+    case Interval::LTZ:
+      return true;
+    case Interval::ZERO:
+      return true;
+    case Interval::GTZ:
+      return false;
+    case Interval::NTZ:
+      return false;
+    case Interval::GEZ:
+      return false;
+    default:
+      break;
+    }
+    break;
+  case Interval::NTZ:
+    switch (other) {
+    case Interval::LTZ:
+      return true;
+    case Interval::ZERO:
+      return false;
+    case Interval::GTZ:
+      return true;
+    case Interval::LEZ:
+      return false;
+    case Interval::GEZ:
+      return false;
+    default:
+      break;
+    }
+    break;
+  case Interval::GEZ:
+    switch (other) {
+    case Interval::LTZ:
+      return false;
+    case Interval::ZERO:
+      return true;
+    case Interval::GTZ:
+      return true;
+    case Interval::LEZ:
+      return false;
+    case Interval::NTZ:
+      return false;
+    default:
+      break;
+    }
+    break;
+  default:
+    abort();
+  }
+  return false;
+}
+
+Interval switchJoin(Interval interval, Interval other_interval) {
+  Interval ret = interval;
+
+  if (interval == other_interval) {
+    return ret;
+  }
+  if (interval == Interval::TOP || other_interval == Interval::TOP) {
+    ret = Interval::TOP;
+    return ret;
+  }
+  if (interval == Interval::BOT) {
+    ret = other_interval;
+    return ret;
+  }
+  if (other_interval == Interval::BOT) {
+    ret = interval;
+    return ret;
+  }
+
+  switch (interval) {
+  case Interval::LTZ:
+    switch (other_interval) {
+    case Interval::ZERO:
+      ret = Interval::LEZ;
+      break;
+    case Interval::GTZ:
+      ret = Interval::NTZ;
+      break;
+    case Interval::LEZ:
+      ret = Interval::LEZ;
+      break;
+    case Interval::NTZ:
+      ret = Interval::NTZ;
+      break;
+    case Interval::GEZ:
+      ret = Interval::TOP;
+      break;
+    default:
+      break;
+    }
+    break;
+  case Interval::ZERO:
+    switch (other_interval) {
+    case Interval::LTZ:
+      ret = Interval::LEZ;
+      break;
+    case Interval::GTZ:
+      ret = Interval::GEZ;
+      break;
+    case Interval::LEZ:
+      ret = Interval::LEZ;
+      break;
+    case Interval::NTZ:
+      ret = Interval::TOP;
+      break;
+    case Interval::GEZ:
+      ret = Interval::GEZ;
+      break;
+    default:
+      break;
+    }
+    break;
+  case Interval::GTZ:
+    switch (other_interval) {
+    case Interval::LTZ:
+      ret = Interval::NTZ;
+      break;
+    case Interval::ZERO:
+      ret = Interval::GEZ;
+      break;
+    case Interval::LEZ:
+      ret = Interval::TOP;
+      break;
+    case Interval::NTZ:
+      ret = Interval::NTZ;
+      break;
+    case Interval::GEZ:
+      ret = Interval::GEZ;
+      break;
+    default:
+      break;
+    }
+    break;
+  case Interval::LEZ:
+    switch (other_interval) {
+    case Interval::LTZ:
+      ret = Interval::LEZ;
+      break;
+    case Interval::ZERO:
+      ret = Interval::LEZ;
+      break;
+    case Interval::GTZ:
+      ret = Interval::TOP;
+      break;
+    case Interval::NTZ:
+      ret = Interval::TOP;
+      break;
+    case Interval::GEZ:
+      ret = Interval::TOP;
+      break;
+    default:
+      break;
+    }
+    break;
+  case Interval::NTZ:
+    switch (other_interval) {
+    case Interval::LTZ:
+      ret = Interval::NTZ;
+      break;
+    case Interval::ZERO:
+      ret = Interval::TOP;
+      break;
+    case Interval::GTZ:
+      ret = Interval::NTZ;
+      break;
+    case Interval::LEZ:
+      ret = Interval::TOP;
+      break;
+    case Interval::GEZ:
+      ret = Interval::TOP;
+      break;
+    default:
+      break;
+    }
+    break;
+  case Interval::GEZ:
+    switch (other_interval) {
+    case Interval::LTZ:
+      ret = Interval::TOP;
+      break;
+    case Interval::ZERO:
+      ret = Interval::GEZ;
+      break;
+    case Interval::GTZ:
+      ret = Interval::GEZ;
+      break;
+    case Interval::LEZ:
+      ret = Interval::TOP;
+      break;
+    case Interval::NTZ:
+      ret = Interval::TOP;
+      break;
+    default:
+      break;
+    }
+    break;
+  default:
+    abort();
+  }
+
+  return ret;
+}
+
+Interval switchMeet(Interval interval, Interval other_interval) {
+  Interval ret = interval;
+
+  if (interval == other_interval) {
+    return ret;
+  }
+
+  if (interval == Interval::BOT || other_interval == Interval::BOT) {
+    ret = Interval::BOT;
+    return ret;
+  }
+  if (interval == Interval::TOP) {
+    ret = other_interval;
+    return ret;
+  }
+  if (other_interval == Interval::TOP) {
+    ret = interval;
+    return ret;
+  }
+
+  switch (interval) {
+  case Interval::LTZ:
+    switch (other_interval) {
+    case Interval::ZERO:
+      ret = Interval::BOT;
+      break;
+    case Interval::GTZ:
+      ret = Interval::BOT;
+      break;
+    case Interval::LEZ:
+      ret = Interval::LTZ;
+      break;
+    case Interval::NTZ:
+      ret = Interval::LTZ;
+      break;
+    case Interval::GEZ:
+      ret = Interval::BOT;
+      break;
+    default:
+      break;
+    }
+    break;
+  case Interval::ZERO:
+    switch (other_interval) {
+    case Interval::LTZ:
+      ret = Interval::BOT;
+      break;
+    case Interval::GTZ:
+      ret = Interval::BOT;
+      break;
+    case Interval::LEZ:
+      ret = Interval::ZERO;
+      break;
+    case Interval::NTZ:
+      ret = Interval::BOT;
+      break;
+    case Interval::GEZ:
+      ret = Interval::ZERO;
+      break;
+    default:
+      break;
+    }
+    break;
+  case Interval::GTZ:
+    switch (other_interval) {
+    case Interval::LTZ:
+      ret = Interval::BOT;
+      break;
+    case Interval::ZERO:
+      ret = Interval::BOT;
+      break;
+    case Interval::LEZ:
+      ret = Interval::BOT;
+      break;
+    case Interval::NTZ:
+      ret = Interval::GTZ;
+      break;
+    case Interval::GEZ:
+      ret = Interval::GTZ;
+      break;
+    default:
+      break;
+    }
+    break;
+  case Interval::LEZ:
+    switch (other_interval) {
+    case Interval::LTZ:
+      ret = Interval::LTZ;
+      break;
+    case Interval::ZERO:
+      ret = Interval::ZERO;
+      break;
+    case Interval::GTZ:
+      ret = Interval::BOT;
+      break;
+    case Interval::NTZ:
+      ret = Interval::LTZ;
+      break;
+    case Interval::GEZ:
+      ret = Interval::ZERO;
+      break;
+    default:
+      break;
+    }
+    break;
+  case Interval::NTZ:
+    switch (other_interval) {
+    case Interval::LTZ:
+      ret = Interval::LTZ;
+      break;
+    case Interval::ZERO:
+      ret = Interval::BOT;
+      break;
+    case Interval::GTZ:
+      ret = Interval::GTZ;
+      break;
+    case Interval::LEZ:
+      ret = Interval::LTZ;
+      break;
+    case Interval::GEZ:
+      ret = Interval::GTZ;
+      break;
+    default:
+      break;
+    }
+    break;
+  case Interval::GEZ:
+    switch (other_interval) {
+    case Interval::LTZ:
+      ret = Interval::BOT;
+      break;
+    case Interval::ZERO:
+      ret = Interval::ZERO;
+      break;
+    case Interval::GTZ:
+      ret = Interval::GTZ;
+      break;
+    case Interval::LEZ:
+      ret = Interval::ZERO;
+      break;
+    case Interval::NTZ:
+      ret = Interval::GTZ;
+      break;
+    default:
+      break;
+    }
+    break;
+  default:
+    abort();
+  }
+
+  return ret;
+}
+
+// ---- Harness ----
+
+const Interval all_intervals[] = {Interval::BOT, Interval::LTZ, Interval::ZERO,
+                                  Interval::GTZ, Interval::GEZ, Interval::LEZ,
+                                  Interval::NTZ, Interval::TOP};
+
+bool checkEquivalence() {
+  bool ok = true;
+  for (Interval a : all_intervals) {
+    for (Interval b : all_intervals) {
+      if (joinIntervals(a, b) != switchJoin(a, b)) {
+        cerr << "join " << a << " " << b << " differs\n";
+        ok = false;
+      }
+      if (meetIntervals(a, b) != switchMeet(a, b)) {
+        cerr << "meet " << a << " " << b << " differs\n";
+        ok = false;
+      }
+      if (intervalCovers(a, b) != switchCovers(a, b)) {
+        cerr << "covers " << a << " " << b << " differs\n";
+        ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
+bool checkVector(const vector<vector<Interval>> &rows) {
+  size_t width = rows[0].size();
+  IntervalVector joined(width);
+  IntervalVector met(width);
+  vector<Interval> expected_join(width, Interval::BOT);
+  vector<Interval> expected_meet(width, Interval::TOP);
+  for (size_t i = 0; i < width; ++i) {
+    met.set(i, Interval::TOP);
+  }
+
+  for (const auto &row : rows) {
+    IntervalVector v(width);
+    for (size_t i = 0; i < width; ++i) {
+      v.set(i, row[i]);
+      expected_join[i] = switchJoin(expected_join[i], row[i]);
+      expected_meet[i] = switchMeet(expected_meet[i], row[i]);
+    }
+    joined.join(v);
+    met.meet(v);
+    if (!joined.covers(v) || !v.covers(met)) {
+      cerr << "IntervalVector covers differs\n";
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < width; ++i) {
+    if (joined.get(i) != expected_join[i] || met.get(i) != expected_meet[i]) {
+      cerr << "IntervalVector lane " << i << " differs\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Nanoseconds per operation of fn(), which performs ops operations
+template <class Fn> double nsPerOp(size_t iterations, size_t ops, Fn fn) {
+  auto start = chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    fn();
+  }
+  auto end = chrono::steady_clock::now();
+  double ns = chrono::duration<double, nano>(end - start).count();
+  return ns / (double(iterations) * ops);
+}
+
+void report(const string &name, double reference_ns, double bits_ns) {
+  cout << left << setw(16) << name << right << fixed << setprecision(3)
+       << setw(10) << reference_ns << setw(10) << bits_ns << setw(9)
+       << setprecision(1) << reference_ns / bits_ns << "x\n";
+}
+
+// Keeps results alive so the loops are not optimized away
+volatile uint64_t sink;
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 50;
+  const size_t num_pairs = 1 << 20;
+  const size_t blocks = 4096;
+  const size_t callees = 64;
+
+  mt19937 rng(42);
+  uniform_int_distribution<int> pick(0, 7);
+  vector<Interval> lhs(num_pairs), rhs(num_pairs);
+  for (size_t i = 0; i < num_pairs; ++i) {
+    lhs[i] = all_intervals[pick(rng)];
+    rhs[i] = all_intervals[pick(rng)];
+  }
+
+  // Constraints on `callees` functions at the exit of `blocks` blocks
+  vector<vector<Interval>> rows(blocks, vector<Interval>(callees));
+  vector<IntervalVector> packed(blocks, IntervalVector(callees));
+  for (size_t b = 0; b < blocks; ++b) {
+    for (size_t c = 0; c < callees; ++c) {
+      rows[b][c] = all_intervals[pick(rng)];
+      packed[b].set(c, rows[b][c]);
+    }
+  }
+
+  if (!checkEquivalence() || !checkVector(rows)) {
+    return 1;
+  }
+  cout << "all lattice operations agree with the reference\n\n";
+  cout << left << setw(16) << "operation" << right << setw(10) << "switch"
+       << setw(10) << "bits" << setw(10) << "speedup" << "\n";
+  cout << left << setw(16) << "" << right << setw(10) << "ns/op" << setw(10)
+       << "ns/op" << "\n";
+
+  report("join",
+         nsPerOp(iterations, num_pairs,
+                 [&]() {
+                   uint64_t acc = 0;
+                   for (size_t i = 0; i < num_pairs; ++i) {
+                     acc += intervalBits(switchJoin(lhs[i], rhs[i]));
+                   }
+                   sink = acc;
+                 }),
+         nsPerOp(iterations, num_pairs, [&]() {
+           uint64_t acc = 0;
+           for (size_t i = 0; i < num_pairs; ++i) {
+             acc += intervalBits(joinIntervals(lhs[i], rhs[i]));
+           }
+           sink = acc;
+         }));
+
+  report("meet",
+         nsPerOp(iterations, num_pairs,
+                 [&]() {
+                   uint64_t acc = 0;
+                   for (size_t i = 0; i < num_pairs; ++i) {
+                     acc += intervalBits(switchMeet(lhs[i], rhs[i]));
+                   }
+                   sink = acc;
+                 }),
+         nsPerOp(iterations, num_pairs, [&]() {
+           uint64_t acc = 0;
+           for (size_t i = 0; i < num_pairs; ++i) {
+             acc += intervalBits(meetIntervals(lhs[i], rhs[i]));
+           }
+           sink = acc;
+         }));
+
+  report("covers",
+         nsPerOp(iterations, num_pairs,
+                 [&]() {
+                   uint64_t acc = 0;
+                   for (size_t i = 0; i < num_pairs; ++i) {
+                     acc += switchCovers(lhs[i], rhs[i]);
+                   }
+                   sink = acc;
+                 }),
+         nsPerOp(iterations, num_pairs, [&]() {
+           uint64_t acc = 0;
+           for (size_t i = 0; i < num_pairs; ++i) {
+             acc += intervalCovers(lhs[i], rhs[i]);
+           }
+           sink = acc;
+         }));
+
+  // Joining the exit facts of all blocks, one callee at a time versus
+  // 21 callees per word
+  report("join 64 callees",
+         nsPerOp(iterations, blocks,
+                 [&]() {
+                   vector<Interval> acc(callees, Interval::BOT);
+                   for (size_t b = 0; b < blocks; ++b) {
+                     for (size_t c = 0; c < callees; ++c) {
+                       acc[c] = switchJoin(acc[c], rows[b][c]);
+                     }
+                   }
+                   sink = intervalBits(acc[0]);
+                 }),
+         nsPerOp(iterations, blocks, [&]() {
+           IntervalVector acc(callees);
+           for (size_t b = 0; b < blocks; ++b) {
+             acc.join(packed[b]);
+           }
+           sink = intervalBits(acc.get(0));
+         }));
+
+  return 0;
+}
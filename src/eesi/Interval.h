@@ -0,0 +1,164 @@
+// The lattice of abstract return values.
+//
+// An Interval is the set of signs {negative, zero, positive} that a value may
+// have, stored as three bits. Join is set union (OR), meet is set
+// intersection (AND) and covers is a subset test. All three are constexpr so
+// they fold away when the operands are known at compile time.
+//
+// Ordered by inclusion: BOT is below <0, ==0 and >0, which are below <=0,
+// !=0 and >=0, which are below TOP.
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+enum class Interval : uint8_t {
+  BOT = 0,
+  LTZ = 1,
+  ZERO = 2,
+  GTZ = 4,
+  GEZ = 6,
+  LEZ = 3,
+  NTZ = 5,
+  TOP = 7
+};
+
+constexpr uint8_t intervalBits(Interval a) { return static_cast<uint8_t>(a); }
+
+constexpr Interval joinIntervals(Interval a, Interval b) {
+  return static_cast<Interval>(intervalBits(a) | intervalBits(b));
+}
+
+constexpr Interval meetIntervals(Interval a, Interval b) {
+  return static_cast<Interval>(intervalBits(a) & intervalBits(b));
+}
+
+// True if every value in b is also in a
+constexpr bool intervalCovers(Interval a, Interval b) {
+  return (intervalBits(a) & intervalBits(b)) == intervalBits(b);
+}
+
+static_assert(joinIntervals(Interval::LTZ, Interval::ZERO) == Interval::LEZ,
+              "join of <0 and ==0");
+static_assert(joinIntervals(Interval::LTZ, Interval::GTZ) == Interval::NTZ,
+              "join of <0 and >0");
+static_assert(joinIntervals(Interval::ZERO, Interval::GTZ) == Interval::GEZ,
+              "join of ==0 and >0");
+static_assert(joinIntervals(Interval::LEZ, Interval::GTZ) == Interval::TOP,
+              "join of <=0 and >0");
+static_assert(meetIntervals(Interval::LEZ, Interval::GEZ) == Interval::ZERO,
+              "meet of <=0 and >=0");
+static_assert(meetIntervals(Interval::NTZ, Interval::ZERO) == Interval::BOT,
+              "meet of !=0 and ==0");
+static_assert(intervalCovers(Interval::NTZ, Interval::GTZ) &&
+                  !intervalCovers(Interval::GTZ, Interval::NTZ),
+              "!=0 covers >0");
+
+// Printed and parsed names, indexed by intervalBits
+constexpr const char *interval_names[8] = {"bottom", "<0",  "==0", "<=0",
+                                           ">0",     "!=0", ">=0", "top"};
+
+// Sets interval to the Interval named name. Returns false if there is none.
+inline bool parseInterval(const std::string &name, Interval &interval) {
+  for (uint8_t bits = 0; bits < 8; ++bits) {
+    if (name == interval_names[bits]) {
+      interval = static_cast<Interval>(bits);
+      return true;
+    }
+  }
+  return false;
+}
+
+inline std::ostream &operator<<(std::ostream &os, const Interval &interval) {
+  uint8_t bits = intervalBits(interval);
+  if (bits < 8) {
+    os << interval_names[bits];
+  } else {
+    os << "???";
+  }
+
+  return os;
+}
+
+// A fixed number of Intervals packed 21 to a 64-bit word. Lanes never carry
+// into each other, so joining, meeting or comparing two vectors is one
+// bitwise operation per word instead of one lattice operation per interval.
+class IntervalVector {
+public:
+  static const unsigned lane_bits = 3;
+  static const unsigned lanes_per_word = 64 / lane_bits;
+
+  IntervalVector() {}
+  explicit IntervalVector(size_t size)
+      : num_intervals(size),
+        words((size + lanes_per_word - 1) / lanes_per_word, 0) {}
+
+  size_t size() const { return num_intervals; }
+
+  Interval get(size_t i) const {
+    assert(i < num_intervals);
+    return static_cast<Interval>((words[i / lanes_per_word] >> shift(i)) & 7);
+  }
+
+  void set(size_t i, Interval interval) {
+    assert(i < num_intervals);
+    uint64_t &word = words[i / lanes_per_word];
+    word = (word & ~(uint64_t(7) << shift(i))) |
+           (uint64_t(intervalBits(interval)) << shift(i));
+  }
+
+  // Returns true if any interval changed
+  bool join(const IntervalVector &other) {
+    assert(num_intervals == other.num_intervals);
+    uint64_t changed = 0;
+    for (size_t w = 0, e = words.size(); w != e; ++w) {
+      uint64_t joined = words[w] | other.words[w];
+      changed |= joined ^ words[w];
+      words[w] = joined;
+    }
+    return changed != 0;
+  }
+
+  // Returns true if any interval changed
+  bool meet(const IntervalVector &other) {
+    assert(num_intervals == other.num_intervals);
+    uint64_t changed = 0;
+    for (size_t w = 0, e = words.size(); w != e; ++w) {
+      uint64_t met = words[w] & other.words[w];
+      changed |= met ^ words[w];
+      words[w] = met;
+    }
+    return changed != 0;
+  }
+
+  // True if every interval covers the interval at the same position in other
+  bool covers(const IntervalVector &other) const {
+    assert(num_intervals == other.num_intervals);
+    for (size_t w = 0, e = words.size(); w != e; ++w) {
+      if ((words[w] & other.words[w]) != other.words[w]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool operator==(const IntervalVector &other) const {
+    return num_intervals == other.num_intervals && words == other.words;
+  }
+  bool operator!=(const IntervalVector &other) const {
+    return !(*this == other);
+  }
+
+private:
+  static unsigned shift(size_t i) { return lane_bits * (i % lanes_per_word); }
+
+  size_t num_intervals = 0;
+  std::vector<uint64_t> words;
+};
+
+#endif
@@ -1,5 +1,13 @@
-#include <iostream>
+#include <algorithm>
+#include <dirent.h>
+#include <functional>
 #include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <sys/stat.h>
 #include <unordered_set>
 
 #include "llvm/Analysis/Passes.h"
@@ -9,6 +17,7 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_os_ostream.h"
 #include "llvm/IR/LLVMContext.h"
 #include <boost/algorithm/string.hpp>
 #include <boost/program_options.hpp>
@@ -17,6 +26,14 @@
 #include "Constraint.h"
 #include "DefinedFunctions.h"
 #include "ErrorBlocks.h"
+#include "ErrorCodes.h"
+#include "ErrorModels.h"
+#include "ErrorSummary.h"
+#include "AnalysisCache.h"
+#include "WarmStart.h"
+#include "ErrorDatabase.h"
+#include "SpecSnapshot.h"
+#include "Relevance.h"
 #include "ReturnPropagation.h"
 #include "ReturnPropagationPointer.h"
 #include "ReturnConstraints.h"
@@ -24,30 +41,136 @@
 #include "ReturnedValues.h"
 #include "CalledFunctions.h"
 #include "MissingChecks.h"
+#include "LazyModule.h"
+#include "Common.h"
+#include "Parallel.hpp"
+#include "SpecFiles.h"
 
 using namespace std;
 using namespace llvm;
 
+// Part of every cache key. Bump it when cached results change meaning.
+#define CACHE_VERSION "2"
+
+// Commands that share one pass pipeline and can be combined
+static const unordered_set<string> analysis_commands = {
+    "specs",   "errorpropagation", "fullpropagation", "bugs",
+    "summary", "warmstart",        "errdb"};
+
+// Commands that can be answered from linked summaries
+static const unordered_set<string> link_commands = {"specs",
+                                                    "errorpropagation"};
+
+// The configuration files, read once no matter how many modules are analyzed
+struct AnalysisConfig {
+  unordered_set<string> error_only;
+  unordered_map<string, Constraint> input_specs;
+  unordered_map<string, Constraint> specs;
+  string debug_function;
+
+  // Models of the error-handling functions, the Linux ones by default
+  vector<errspec::ModelRule> models = errspec::defaultErrorModels();
+
+  // Constants that are error codes, the Linux ones by default
+  errspec::ErrorCodeTable error_codes = errspec::defaultErrorCodes();
+
+  // The specs file, if it is a snapshot. specs is then empty.
+  shared_ptr<const errspec::SpecSnapshot> specs_snapshot;
+
+  // The specs command writes a snapshot instead of text
+  bool binary_specs = false;
+
+  // Per-function results of earlier runs, if --cache is given
+  const errspec::AnalysisCache *cache = nullptr;
+
+  // Specifications of an earlier run, if --warmstart is given
+  const errspec::WarmStart *warm_start = nullptr;
+  bool verify_warm_start = false;
+
+  // Where errdb writes its database
+  string database;
+};
+
+AnalysisConfig readConfig(const vector<string> &commands,
+                          string error_only_path, string input_specs_path,
+                          string specs_path, string debug_function);
+
+// The bitcode files of a batch
+bool readBitcodeList(string list_path, vector<string> &bitcode_paths);
+
+// Run the commands on one bitcode file, or on each file of a batch. Both
+// return false if a file cannot be read.
+bool runCommands(string bitcode_path, const vector<string> &commands,
+                 const vector<ostream *> &outputs,
+                 const AnalysisConfig &config, bool lazy, bool aggregate,
+                 unsigned jobs);
+bool runBatch(const vector<string> &bitcode_paths,
+              const vector<string> &commands,
+              const vector<ostream *> &outputs, const AnalysisConfig &config,
+              bool lazy, bool aggregate, unsigned jobs);
+
 // commands
-void calledfunctions(Module &Mod);
-void definedfunctions(Module &Mod);
-void bugs(Module &Mod, string specs_path, string error_only_path, string debug_function);
-void errorpropagation(Module &Mod, string error_only_path,
-                      string input_specs_path);
-void fullpropagation(Module &Mod, string error_only_path);
-void specs(Module &Mod, string error_only_path, string input_specs_path);
+bool calledfunctions(string bitcode_path, bool aggregate, ostream &out);
+bool definedfunctions(string bitcode_path, ostream &out);
+void analyze(Module &Mod, const vector<string> &commands,
+             const vector<ostream *> &outputs, const AnalysisConfig &config,
+             unsigned jobs);
+void analyzeCached(Module &Mod, const vector<string> &commands,
+                   const vector<ostream *> &outputs,
+                   const AnalysisConfig &config, unsigned jobs);
+
+// Adds ReturnPropagation, ReturnConstraints and ReturnedValues, keeping
+// facts only where ReturnConstraints and ErrorBlocks read them
+ReturnedValues *addReturnAnalyses(legacy::PassManager &PM, unsigned jobs,
+                                  errspec::FunctionScope scope);
+
+// The error models and the error codes of the module, one line per entry,
+// for hashing. The codes of enums depend on the debug info of the module.
+vector<string> formatTables(const AnalysisConfig &config,
+                            const errspec::ErrorCodeClassifier &error_codes);
+
+// Function bodies needed by the commands when loading lazily
+errspec::BodyFilter neededBodies(const vector<string> &commands,
+                                 const AnalysisConfig &config);
+
+// output of the analysis commands
+void printSpecs(const unordered_map<string, Constraint> &specs, bool binary,
+                ostream &out);
+void printErrorPropagation(const set<ErrorPropagationEdge> &error_propagation,
+                           const unordered_set<string> &error_only_bootstrap,
+                           const unordered_map<string, Constraint> &specs,
+                           ostream &out);
+void printSummaries(const vector<errspec::FunctionSummary> &summaries,
+                    ostream &out);
+
+// Solves the specifications of the program from the summaries of its modules
+bool link(const vector<string> &summary_paths, const vector<string> &commands,
+          const vector<ostream *> &outputs, string input_specs_path,
+          bool binary_specs);
+void printFullPropagation(ReturnedValues &returned_values, ostream &out);
 
 int main(int argc, char **argv) {
   namespace po = boost::program_options;
   po::options_description desc("Options");
   desc.add_options()("help", "produce help message")
-      ("bitcode", po::value<string>()->required(), "Path to bitcode file")
-      ("command", po::value<string>()->required(), "Command (See README)")
-      ("output", po::value<string>(), "Path to output file")
+      ("bitcode", po::value<string>(), "Path to bitcode file")
+      ("bitcode-list", po::value<string>(), "Path to a file listing bitcode files, one per line, or to a directory of .bc files")
+      ("summaries", po::value<string>(), "Comma-separated paths to summary files to link instead of analyzing bitcode")
+      ("cache", po::value<string>(), "Directory of per-function results reused by later runs")
+      ("warmstart", po::value<string>(), "Start from the output of the warmstart command of an earlier run")
+      ("verify-warmstart", po::bool_switch(), "With --warmstart, check that the specifications equal a cold run")
+      ("snapshot", po::bool_switch(), "With specs, write a binary spec snapshot that --specs and --inputspecs map without parsing")
+      ("command", po::value<string>()->required(), "Command (See README), or a comma-separated list of analysis commands")
+      ("output", po::value<string>(), "Path to output file, comma-separated with one per command")
       ("erroronly", po::value<string>(), "Path to error-only functions file")
       ("inputspecs", po::value<string>(), "Path to input specs list file")
       ("specs", po::value<string>(), "Path to specs file")
-      ("debugfunction", po::value<string>(), "Print log messages when processing this function");
+      ("models", po::value<string>(), "Path to error models file (default: the Linux ERR_PTR, IS_ERR, PTR_ERR and ERR_CAST)")
+      ("errorcodes", po::value<string>(), "Path to error codes file (default: config/error-codes-linux.txt)")
+      ("debugfunction", po::value<string>(), "Print log messages when processing this function")
+      ("jobs", po::value<unsigned>()->default_value(1), "Number of threads. With --bitcode-list, the number of modules analyzed at once")
+      ("lazy", po::bool_switch(), "With bugs on its own, read function bodies one at a time and keep only those that call a function with a spec or an error-only function")
+      ("aggregate", po::bool_switch(), "With calledfunctions, print each callee with its number of calls and calling functions");
   po::variables_map varmap;
   try {
     po::store(po::parse_command_line(argc, argv, desc), varmap);
@@ -74,25 +197,87 @@ int main(int argc, char **argv) {
                                           "bugs",
                                           "errorpropagation",
                                           "fullpropagation",
-                                          "usagespecs"};
+                                          "usagespecs",
+                                          "summary",
+                                          "warmstart"};
 
   string command = varmap["command"].as<string>();
-  if (valid_commands.find(command) == valid_commands.end()) {
-    cerr << "Command must be one of: " << endl;
-    for (auto const &cmd : valid_commands) {
-      cerr << cmd << endl;
+  vector<string> commands;
+  boost::split(commands, command, boost::is_any_of(","));
+  for (const string &cmd : commands) {
+    if (valid_commands.find(cmd) == valid_commands.end()) {
+      cerr << "Command must be one of: " << endl;
+      for (auto const &valid : valid_commands) {
+        cerr << valid << endl;
+      }
+      return 1;
+    }
+    if (commands.size() > 1 &&
+        analysis_commands.find(cmd) == analysis_commands.end()) {
+      cerr << "Only these commands can be combined: " << endl;
+      for (auto const &analysis : analysis_commands) {
+        cerr << analysis << endl;
+      }
+      return 1;
+    }
+    if (count(commands.begin(), commands.end(), cmd) > 1) {
+      cerr << "Command " << cmd << " given more than once" << endl;
+      return 1;
     }
-    return 1;
   }
 
-  string bitcode_path = varmap["bitcode"].as<string>();
+  bool batch = varmap.count("bitcode-list");
+  bool linking = varmap.count("summaries");
+  if (varmap.count("bitcode") + batch + linking != 1) {
+    cerr << "ERROR: Give exactly one of --bitcode, --bitcode-list and "
+            "--summaries"
+         << endl
+         << endl;
+    cerr << desc << endl;
+    return 1;
+  }
+  string bitcode_path;
+  if (varmap.count("bitcode")) {
+    bitcode_path = varmap["bitcode"].as<string>();
+  }
+  if (linking) {
+    for (const string &cmd : commands) {
+      if (link_commands.find(cmd) == link_commands.end()) {
+        cerr << "Only these commands can be run on summaries: " << endl;
+        for (auto const &link_command : link_commands) {
+          cerr << link_command << endl;
+        }
+        return 1;
+      }
+    }
+  }
   string function;
   if (varmap.count("function")) {
     function = varmap["function"].as<string>();
   }
-  string output;
+  vector<string> output_paths;
   if (varmap.count("output")) {
-    output = varmap["output"].as<string>();
+    boost::split(output_paths, varmap["output"].as<string>(),
+                 boost::is_any_of(","));
+    if (output_paths.size() != commands.size()) {
+      cerr << "ERROR: --output needs one path per command" << endl;
+      return 1;
+    }
+  }
+  auto errdb = find(commands.begin(), commands.end(), "errdb");
+  if (errdb != commands.end() &&
+      (output_paths.empty() || batch || varmap.count("cache"))) {
+    cerr << "ERROR: errdb needs --output and --bitcode, and cannot use --cache"
+         << endl;
+    return 1;
+  }
+
+  // The other analysis commands need every body, so --lazy would only read
+  // them one at a time and keep them all
+  bool lazy = varmap["lazy"].as<bool>();
+  if (lazy && (commands.size() != 1 || commands.front() != "bugs")) {
+    cerr << "ERROR: --lazy only applies to the bugs command on its own" << endl;
+    return 1;
   }
 
   string error_only_path;
@@ -115,50 +300,782 @@ int main(int argc, char **argv) {
     debug_function = varmap["debugfunction"].as<string>();
   }
 
+  vector<errspec::ModelRule> models = errspec::defaultErrorModels();
+  if (varmap.count("models")) {
+    string models_path = varmap["models"].as<string>();
+    models.clear();
+    if (!errspec::readErrorModelsFile(models_path, models)) {
+      cerr << "ERROR: Cannot read error models file: " << models_path << endl;
+      return 1;
+    }
+  }
+
+  errspec::ErrorCodeTable error_codes = errspec::defaultErrorCodes();
+  if (varmap.count("errorcodes")) {
+    string error_codes_path = varmap["errorcodes"].as<string>();
+    error_codes = errspec::ErrorCodeTable();
+    if (!errspec::readErrorCodesFile(error_codes_path, error_codes)) {
+      cerr << "ERROR: Cannot read error codes file: " << error_codes_path
+           << endl;
+      return 1;
+    }
+  }
+
+  bool binary_specs = varmap["snapshot"].as<bool>();
+
+  unsigned jobs = varmap["jobs"].as<unsigned>();
+  if (jobs == 0) {
+    jobs = 1;
+  }
+
   google::InitGoogleLogging(argv[0]);
 
+  // Read before the output files are opened, which may overwrite it
+  errspec::WarmStart warm_start;
+  if (varmap.count("warmstart")) {
+    if (!varmap.count("bitcode") || varmap.count("cache")) {
+      cerr << "ERROR: --warmstart needs --bitcode and cannot use --cache"
+           << endl;
+      return 1;
+    }
+    string warm_start_path = varmap["warmstart"].as<string>();
+    ifstream warm_start_file(warm_start_path);
+    if (!warm_start_file ||
+        !errspec::readWarmStart(warm_start_file, warm_start)) {
+      cerr << "FATAL: Cannot read warm start file: " << warm_start_path
+           << endl;
+      abort();
+    }
+  }
+
+  // Each command writes to its output file. Without output files a single
+  // command prints to stdout directly, and several commands are buffered and
+  // printed one after another.
+  vector<unique_ptr<ostream>> files;
+  vector<ostream *> outputs;
+  for (size_t i = 0; i < commands.size(); ++i) {
+    if (commands[i] == "errdb") {
+      // The database is written by SQLite, not through a stream
+      files.emplace_back(new ostringstream);
+      outputs.push_back(files.back().get());
+    } else if (!output_paths.empty()) {
+      files.emplace_back(new ofstream(output_paths[i]));
+      if (!*files.back()) {
+        cerr << "FATAL: Cannot open output file: " << output_paths[i] << endl;
+        abort();
+      }
+      outputs.push_back(files.back().get());
+    } else if (commands.size() == 1) {
+      outputs.push_back(&cout);
+    } else {
+      files.emplace_back(new ostringstream);
+      outputs.push_back(files.back().get());
+    }
+  }
+
+  if (linking) {
+    vector<string> summary_paths;
+    boost::split(summary_paths, varmap["summaries"].as<string>(),
+                 boost::is_any_of(","));
+    if (!link(summary_paths, commands, outputs, input_specs_path,
+              binary_specs)) {
+      abort();
+    }
+    if (output_paths.empty() && commands.size() > 1) {
+      for (const auto &file : files) {
+        cout << static_cast<ostringstream &>(*file).str();
+      }
+    }
+    return 0;
+  }
+
+  AnalysisConfig config;
+  if (analysis_commands.find(commands.front()) != analysis_commands.end()) {
+    config = readConfig(commands, error_only_path, input_specs_path,
+                        specs_path, debug_function);
+  }
+  unique_ptr<errspec::AnalysisCache> cache;
+  if (varmap.count("cache")) {
+    // The error propagation edges of linked summaries depend on the order
+    // the rules fire in, so they could differ from an uncached run
+    if (count(commands.begin(), commands.end(), "fullpropagation") ||
+        count(commands.begin(), commands.end(), "errorpropagation") ||
+        count(commands.begin(), commands.end(), "warmstart")) {
+      cerr << "ERROR: fullpropagation, errorpropagation and warmstart cannot "
+              "use --cache"
+           << endl;
+      return 1;
+    }
+    cache.reset(new errspec::AnalysisCache(varmap["cache"].as<string>()));
+    config.cache = cache.get();
+  }
+  config.binary_specs = binary_specs;
+  config.models = models;
+  config.error_codes = error_codes;
+  if (errdb != commands.end()) {
+    config.database = output_paths[errdb - commands.begin()];
+  }
+  if (varmap.count("warmstart")) {
+    config.warm_start = &warm_start;
+    config.verify_warm_start = varmap["verify-warmstart"].as<bool>();
+  }
+  bool aggregate = varmap["aggregate"].as<bool>();
+
+  int status = 0;
+  if (!batch) {
+    if (!runCommands(bitcode_path, commands, outputs, config, lazy, aggregate,
+                     jobs)) {
+      cerr << "FATAL: Error parsing bitcode file: " << bitcode_path << endl;
+      abort();
+    }
+  } else {
+    string list_path = varmap["bitcode-list"].as<string>();
+    vector<string> bitcode_paths;
+    if (!readBitcodeList(list_path, bitcode_paths)) {
+      cerr << "FATAL: Cannot read bitcode list: " << list_path << endl;
+      abort();
+    }
+    if (!runBatch(bitcode_paths, commands, outputs, config, lazy, aggregate,
+                  jobs)) {
+      status = 1;
+    }
+  }
+
+  if (output_paths.empty() && commands.size() > 1) {
+    for (const auto &file : files) {
+      cout << static_cast<ostringstream &>(*file).str();
+    }
+  }
+
+  return status;
+}
+
+// Warns about the empty files that the commands read, as the passes did when
+// they read the files themselves
+AnalysisConfig readConfig(const vector<string> &commands,
+                          string error_only_path, string input_specs_path,
+                          string specs_path, string debug_function) {
+  auto requested = [&](const string &cmd) {
+    return find(commands.begin(), commands.end(), cmd) != commands.end();
+  };
+  bool infer = requested("specs") || requested("errorpropagation") ||
+               requested("warmstart") || requested("errdb");
+
+  AnalysisConfig config;
+  config.error_only = errspec::readErrorOnlyFile(error_only_path);
+  config.debug_function = debug_function;
+
+  if (infer) {
+    config.input_specs = errspec::readInputSpecsFile(input_specs_path);
+    if (config.input_specs.empty()) {
+      LOG(WARNING) << "EMPTY INPUT SPECS LIST!\n";
+    }
+  }
+  if ((infer || requested("summary")) && config.error_only.empty()) {
+    LOG(WARNING) << "EMPTY ERROR-ONLY SET!";
+  }
+  // Specs inferred in the same run replace the specs file
+  if (requested("bugs") && !infer) {
+    // A snapshot is mapped and read in place by MissingChecks
+    if (errspec::SpecSnapshot::isSnapshot(specs_path)) {
+      string error;
+      config.specs_snapshot = errspec::SpecSnapshot::open(specs_path, error);
+      if (!config.specs_snapshot) {
+        cerr << "WARNING: " << specs_path << ": " << error << "\n";
+      }
+    } else {
+      config.specs = errspec::readSpecsFile(specs_path);
+    }
+    if (config.specs.empty() &&
+        (!config.specs_snapshot || !config.specs_snapshot->size())) {
+      cerr << "WARNING: EMPTY INPUT SPECS LIST!\n";
+    }
+  }
+  if (requested("bugs") || requested("errdb")) {
+    if (config.error_only.empty()) {
+      cerr << "WARNING: EMPTY ERROR-ONLY SET!\n";
+    }
+  }
+  return config;
+}
+
+// A directory stands for the .bc files in it, sorted by name. Any other path
+// is a list file with one bitcode path per line.
+bool readBitcodeList(string list_path, vector<string> &bitcode_paths) {
+  struct stat st;
+  if (stat(list_path.c_str(), &st) != 0) {
+    return false;
+  }
+
+  if (S_ISDIR(st.st_mode)) {
+    DIR *dir = opendir(list_path.c_str());
+    if (!dir) {
+      return false;
+    }
+    while (struct dirent *entry = readdir(dir)) {
+      string name = entry->d_name;
+      if (name.size() > 3 && name.compare(name.size() - 3, 3, ".bc") == 0) {
+        bitcode_paths.push_back(list_path + "/" + name);
+      }
+    }
+    closedir(dir);
+    std::sort(bitcode_paths.begin(), bitcode_paths.end());
+    return true;
+  }
+
+  ifstream list_file(list_path);
+  if (!list_file) {
+    return false;
+  }
+  string line;
+  while (getline(list_file, line)) {
+    boost::trim(line);
+    if (!line.empty()) {
+      bitcode_paths.push_back(line);
+    }
+  }
+  return true;
+}
+
+bool runCommands(string bitcode_path, const vector<string> &commands,
+                 const vector<ostream *> &outputs,
+                 const AnalysisConfig &config, bool lazy, bool aggregate,
+                 unsigned jobs) {
+  // Neither command needs the module in memory, see below
+  if (commands.front() == "definedfunctions") {
+    return definedfunctions(bitcode_path, *outputs.front());
+  }
+  if (commands.front() == "calledfunctions") {
+    return calledfunctions(bitcode_path, aggregate, *outputs.front());
+  }
+
   SMDiagnostic Err;
   LLVMContext Context;
-  unique_ptr<Module> Mod(parseIRFile(bitcode_path, Err, Context));
+  unique_ptr<Module> Mod;
+  if (lazy) {
+    Mod = errspec::loadModuleLazily(bitcode_path, Err, Context,
+                                    neededBodies(commands, config));
+  } else {
+    Mod = parseIRFile(bitcode_path, Err, Context);
+  }
   if (!Mod) {
-    cerr << "FATAL: Error parsing bitcode file: " << bitcode_path << endl;
-    abort();
-  }
-
-  if (command == "specs") {
-    specs(*Mod, error_only_path, input_specs_path);
-  } else if (command == "bugs") {
-    bugs(*Mod, specs_path, error_only_path, debug_function);
-  } else if (command == "definedfunctions") {
-    definedfunctions(*Mod);
-  } else if (command == "calledfunctions") {
-    calledfunctions(*Mod);
-  } else if (command == "errorpropagation") {
-    errorpropagation(*Mod, error_only_path, input_specs_path);
-  } else if (command == "fullpropagation") {
-    fullpropagation(*Mod, error_only_path);
-  } 
-
-  return 0;
+    return false;
+  }
+
+  if (analysis_commands.find(commands.front()) == analysis_commands.end()) {
+    return true;
+  }
+  if (config.cache) {
+    analyzeCached(*Mod, commands, outputs, config, jobs);
+  } else {
+    analyze(*Mod, commands, outputs, config, jobs);
+  }
+  return true;
+}
+
+// Modules are analyzed jobs at a time, each on one thread with its own
+// LLVMContext. Every module's output is buffered and appended to the output
+// of its command in list order, so the result does not depend on jobs.
+// A module that cannot be read is reported and skipped.
+bool runBatch(const vector<string> &bitcode_paths,
+              const vector<string> &commands,
+              const vector<ostream *> &outputs, const AnalysisConfig &config,
+              bool lazy, bool aggregate, unsigned jobs) {
+  size_t num_commands = commands.size();
+  vector<ostringstream> buffers(bitcode_paths.size() * num_commands);
+  vector<char> parsed(bitcode_paths.size());
+
+  errspec::parallelFor(jobs, bitcode_paths.size(), [&](size_t m) {
+    vector<ostream *> module_outputs;
+    for (size_t i = 0; i < num_commands; ++i) {
+      module_outputs.push_back(&buffers[m * num_commands + i]);
+    }
+    parsed[m] = runCommands(bitcode_paths[m], commands, module_outputs,
+                            config, lazy, aggregate, 1);
+    LOG(INFO) << "Finished " << bitcode_paths[m];
+  });
+
+  bool all_parsed = true;
+  for (size_t m = 0; m < bitcode_paths.size(); ++m) {
+    if (!parsed[m]) {
+      cerr << "ERROR: Error parsing bitcode file: " << bitcode_paths[m]
+           << endl;
+      all_parsed = false;
+    }
+  }
+  for (size_t i = 0; i < num_commands; ++i) {
+    for (size_t m = 0; m < bitcode_paths.size(); ++m) {
+      *outputs[i] << buffers[m * num_commands + i].str();
+    }
+  }
+  return all_parsed;
+}
+
+vector<string> formatTables(const AnalysisConfig &config,
+                            const errspec::ErrorCodeClassifier &error_codes) {
+  vector<string> lines = errspec::formatErrorModels(config.models);
+  for (const string &line : error_codes.format()) {
+    lines.push_back(line);
+  }
+  return lines;
 }
 
-void fullpropagation(Module &Mod, string error_only_path) {
+// MissingChecks only reports calls to functions with a spec or to error-only
+// functions, so bugs on its own needs only the bodies that make such calls.
+// Spec inference follows error values across calls and needs every body;
+// main rejects --lazy for it.
+errspec::BodyFilter neededBodies(const vector<string> &commands,
+                                 const AnalysisConfig &config) {
+  if (commands.size() != 1 || commands.front() != "bugs") {
+    return [](const Function &) { return true; };
+  }
+
+  unordered_set<string> checked = config.error_only;
+  for (const auto &spec : config.specs) {
+    checked.insert(spec.first);
+  }
+  if (config.specs_snapshot) {
+    for (size_t i = 0; i < config.specs_snapshot->size(); ++i) {
+      checked.insert(config.specs_snapshot->name(i));
+    }
+  }
+
+  return [checked](const Function &F) {
+    for (const BasicBlock &BB : F) {
+      for (const Instruction &I : BB) {
+        const CallInst *call = dyn_cast<CallInst>(&I);
+        if (call && checked.count(errspec::getCalleeName(*call))) {
+          return true;
+        }
+      }
+    }
+    return false;
+  };
+}
+
+void analyze(Module &Mod, const vector<string> &commands,
+             const vector<ostream *> &outputs, const AnalysisConfig &config,
+             unsigned jobs) {
+  auto requested = [&](const string &cmd) {
+    return find(commands.begin(), commands.end(), cmd) != commands.end();
+  };
+  bool infer = requested("specs") || requested("errorpropagation") ||
+               requested("warmstart") || requested("errdb");
+  bool need_error_blocks = infer || requested("summary");
+  bool need_returned_values = need_error_blocks || requested("fullpropagation");
+
+  // With a warm start, only the dirty functions need dataflow facts, unless
+  // another command reads them all or every function is solved again
+  string config_hash;
+  unordered_map<string, string> hashes;
+  unordered_set<const Function *> dirty;
+  errspec::FunctionScope scope;
+  bool warm = infer && config.warm_start;
+  errspec::ErrorCodeClassifier error_codes(config.error_codes, &Mod);
+  if (warm || requested("warmstart")) {
+    config_hash = errspec::hashConfig(config.error_only, config.input_specs,
+                                      formatTables(config, error_codes));
+    hashes = errspec::hashFunctions(Mod, jobs);
+  }
+  if (warm) {
+    dirty = errspec::dirtyFunctions(Mod, *config.warm_start, hashes,
+                                    config_hash);
+  }
+
+  // Only the functions that can get a spec need dataflow facts, unless a
+  // command reads them all (see Relevance.h)
+  bool every_function = requested("summary") || requested("fullpropagation");
+  unordered_set<const Function *> relevant;
+  if (infer) {
+    relevant = errspec::specRelevantFunctions(
+        Mod, config.error_only, config.input_specs, error_codes);
+    LOG(INFO) << "Relevant to specs: " << relevant.size() << " of "
+              << Mod.size() << " functions";
+  }
+  bool dirty_only = warm && !config.verify_warm_start && !every_function;
+  if (infer && !every_function) {
+    scope.restrictTo([&relevant, &dirty, dirty_only](const Function &F) {
+      return relevant.count(&F) > 0 && (!dirty_only || dirty.count(&F) > 0);
+    });
+  }
+
+  // The bugs pipeline needs only the callers of functions with a spec. The
+  // specs inferred in this run are among the relevant functions and the
+  // input specs.
+  unordered_set<const Function *> checked;
+  if (requested("bugs") || requested("errdb")) {
+    function<bool(const string &)> has_spec;
+    if (infer) {
+      has_spec = [&](const string &fname) {
+        const Function *F = Mod.getFunction(fname);
+        return config.input_specs.count(fname) > 0 ||
+               (F && relevant.count(F) > 0);
+      };
+    } else if (config.specs_snapshot) {
+      has_spec = [&config](const string &fname) {
+        Interval interval;
+        return config.specs_snapshot->find(fname, interval);
+      };
+    } else {
+      has_spec = [&config](const string &fname) {
+        return config.specs.count(fname) > 0;
+      };
+    }
+    checked = errspec::checkRelevantFunctions(Mod, has_spec);
+    LOG(INFO) << "Relevant to bugs: " << checked.size() << " of "
+              << Mod.size() << " functions";
+  }
+  errspec::FunctionScope check_scope;
+  check_scope.restrictTo(
+      [&checked](const Function &F) { return checked.count(&F) > 0; });
+
+  // Every command adds its passes to one pass manager, so the module is
+  // analyzed once no matter how many commands read the results. Analyses are
+  // added before the passes that use them so that the pass manager does not
+  // create a second, single-threaded instance.
   legacy::PassManager PM;
-  ReturnPropagation *return_propagation = new ReturnPropagation();
-  ReturnConstraints *return_constraints = new ReturnConstraints();
-  ErrorBlocks *error_blocks = new ErrorBlocks(error_only_path);
-  ReturnedValues *returned_values = new ReturnedValues();
+  PM.add(new ErrorModels(config.models));
+
+  ReturnedValues *returned_values = nullptr;
+  if (need_returned_values) {
+    returned_values = addReturnAnalyses(PM, jobs, scope);
+  }
+
+  ErrorBlocks *error_blocks = nullptr;
+  if (need_error_blocks) {
+    error_blocks =
+        new ErrorBlocks(config.error_only, config.input_specs, jobs);
+    error_blocks->summarize = requested("summary");
+    error_blocks->infer = infer;
+    error_blocks->error_code_table = config.error_codes;
+    error_blocks->scope = scope;
+    if (warm) {
+      error_blocks->warmStart(*config.warm_start, dirty);
+      error_blocks->verify_warm_start = config.verify_warm_start;
+    }
+    PM.add(error_blocks);
+  }
+
+  // errdb checks the call sites like bugs and stores the results
+  vector<MissingChecks *> checkers(commands.size());
+  for (size_t i = 0; i < commands.size(); ++i) {
+    if (commands[i] != "bugs" && commands[i] != "errdb") {
+      continue;
+    }
+    ReturnPropagationPointer *return_propagation =
+        new ReturnPropagationPointer(config.debug_function, jobs);
+    ReturnConstraintsPointer *return_constraints =
+        new ReturnConstraintsPointer(jobs);
+    MissingChecks *missing_checks =
+        config.specs_snapshot
+            ? new MissingChecks(config.specs_snapshot, config.error_only,
+                                config.debug_function, jobs)
+            : new MissingChecks(config.specs, config.error_only,
+                                config.debug_function, jobs);
+    // MissingChecks reads constraints only at block exits
+    return_constraints->retention.keepBoundariesOnly();
+    return_propagation->scope = check_scope;
+    return_constraints->scope = check_scope;
+    missing_checks->scope = check_scope;
+    // Specs inferred in this run are checked without a round trip through
+    // a specs file
+    if (infer) {
+      missing_checks->spec_source = error_blocks;
+    }
+    missing_checks->output = outputs[i];
+    checkers[i] = missing_checks;
+
+    PM.add(return_propagation);
+    PM.add(return_constraints);
+    PM.add(missing_checks);
+  }
+
+  PM.run(Mod);
+
+  for (size_t i = 0; i < commands.size(); ++i) {
+    if (commands[i] == "specs") {
+      printSpecs(error_blocks->getErrorReturnValues(), config.binary_specs,
+                 *outputs[i]);
+    } else if (commands[i] == "errorpropagation") {
+      printErrorPropagation(error_blocks->error_propagation,
+                            error_blocks->error_only_bootstrap,
+                            error_blocks->getErrorReturnValues(),
+                            *outputs[i]);
+    } else if (commands[i] == "fullpropagation") {
+      printFullPropagation(*returned_values, *outputs[i]);
+    } else if (commands[i] == "summary") {
+      printSummaries(error_blocks->getSummaries(), *outputs[i]);
+    } else if (commands[i] == "warmstart") {
+      errspec::WarmStart state;
+      state.config = config_hash;
+      state.hashes = hashes;
+      state.specs = error_blocks->getErrorReturnValues();
+      state.error_propagation = error_blocks->error_propagation;
+      state.error_only_bootstrap = error_blocks->error_only_bootstrap;
+      errspec::writeWarmStart(state, *outputs[i]);
+    } else if (commands[i] == "errdb") {
+      errspec::ErrorResults results;
+      results.specs = error_blocks->getErrorReturnValues();
+      results.error_propagation = error_blocks->error_propagation;
+      results.error_only_bootstrap = error_blocks->error_only_bootstrap;
+      results.checked_calls = checkers[i]->getCheckedCalls();
+      results.unchecked_calls = checkers[i]->getUncheckedCalls();
+      results.unchecked_locs = checkers[i]->getUncheckedLocations();
+      results.error_only_reports = checkers[i]->getErrorOnlyReports();
+      string error;
+      if (!errspec::writeErrorDatabase(config.database, results, error)) {
+        cerr << "FATAL: Cannot write database: " << config.database << ": "
+             << error << endl;
+        abort();
+      }
+    }
+  }
+
+  if (warm && !error_blocks->warm_start_verified) {
+    cerr << "ERROR: Warm start differs from a cold run" << endl;
+    exit(1);
+  }
+}
+
+ReturnedValues *addReturnAnalyses(legacy::PassManager &PM, unsigned jobs,
+                                  errspec::FunctionScope scope) {
+  ReturnPropagation *return_propagation = new ReturnPropagation(jobs);
+  ReturnConstraints *return_constraints = new ReturnConstraints(jobs);
+  ReturnedValues *returned_values = new ReturnedValues(jobs);
+  return_propagation->retention.keepBoundariesOnly();
+  return_propagation->retention.keep(ReturnConstraints::readsPropagationFactAt);
+  return_constraints->retention.keepBoundariesOnly();
+  returned_values->retention.keepBoundariesOnly();
+  returned_values->retention.keep(ErrorBlocks::readsReturnedValuesAt);
+  return_propagation->scope = scope;
+  return_constraints->scope = scope;
+  returned_values->scope = scope;
   PM.add(return_propagation);
   PM.add(return_constraints);
   PM.add(returned_values);
+  return returned_values;
+}
+
+// The summaries of functions, from the cache or from ErrorBlocks for the
+// functions that missed it. Summaries do not depend on any specification,
+// so they are keyed by the IR of the function and the configuration alone.
+vector<errspec::FunctionSummary>
+cachedSummaries(Module &Mod, const vector<Function *> &functions,
+                const vector<string> &keys, const AnalysisConfig &config,
+                unsigned jobs) {
+  const errspec::AnalysisCache &cache = *config.cache;
+  vector<errspec::FunctionSummary> summaries(functions.size());
+  vector<char> cached(functions.size());
+  errspec::parallelFor(jobs, functions.size(), [&](size_t i) {
+    string entry;
+    vector<errspec::FunctionSummary> read;
+    if (cache.lookup("summary", keys[i], entry)) {
+      istringstream in(entry);
+      if (errspec::readSummaries(in, read) && read.size() == 1) {
+        summaries[i] = read.front();
+        cached[i] = true;
+      }
+    }
+  });
+
+  unordered_set<const Function *> missed;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    if (!cached[i]) {
+      missed.insert(functions[i]);
+    }
+  }
+  LOG(INFO) << "Cached summaries for " << functions.size() - missed.size()
+            << " of " << functions.size() << " functions";
+  if (missed.empty()) {
+    return summaries;
+  }
+
+  errspec::FunctionScope scope;
+  scope.restrictTo(
+      [&missed](const Function &F) { return missed.count(&F) > 0; });
+
+  legacy::PassManager PM;
+  PM.add(new ErrorModels(config.models));
+  addReturnAnalyses(PM, jobs, scope);
+  ErrorBlocks *error_blocks =
+      new ErrorBlocks(config.error_only, {}, jobs);
+  error_blocks->summarize = true;
+  error_blocks->summary_scope = scope;
+  error_blocks->infer = false;
+  error_blocks->error_code_table = config.error_codes;
+  PM.add(error_blocks);
+  PM.run(Mod);
+
+  // In module order, like functions
+  vector<errspec::FunctionSummary> fresh = error_blocks->getSummaries();
+  size_t next = 0;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    if (cached[i]) {
+      continue;
+    }
+    summaries[i] = fresh[next++];
+    ostringstream entry;
+    errspec::writeSummaries({summaries[i]}, entry);
+    cache.store("summary", keys[i], entry.str());
+  }
+  return summaries;
+}
+
+// Prints the bugs of the module, checking only the call sites of functions
+// whose results are not cached. The results of a function depend on the
+// specifications of its callees and on the calls just before it in the
+// module, which are part of its key.
+void cachedBugs(Module &Mod, const vector<Function *> &functions,
+                const vector<string> &function_keys,
+                const unordered_map<string, Constraint> &specs,
+                const AnalysisConfig &config, unsigned jobs, ostream &out) {
+  const errspec::AnalysisCache &cache = *config.cache;
+  vector<string> keys(functions.size());
+  vector<vector<MissingChecks::CallSiteResult>> results(functions.size());
+  vector<char> cached(functions.size());
+  errspec::parallelFor(jobs, functions.size(), [&](size_t i) {
+    vector<string> callees = CalledFunctions::getCallees(*functions[i]);
+    std::sort(callees.begin(), callees.end());
+    callees.erase(unique(callees.begin(), callees.end()), callees.end());
+
+    vector<string> parts = {function_keys[i]};
+    for (const string &call : MissingChecks::callsBefore(*functions[i])) {
+      parts.push_back(call);
+    }
+    for (const string &callee : callees) {
+      auto spec = specs.find(callee);
+      ostringstream part;
+      part << callee << " ";
+      if (spec == specs.end()) {
+        part << "-";
+      } else {
+        part << spec->second.interval;
+      }
+      parts.push_back(part.str());
+    }
+    keys[i] = errspec::hashStrings(parts);
+
+    string entry;
+    if (cache.lookup("bugs", keys[i], entry)) {
+      istringstream in(entry);
+      cached[i] = MissingChecks::readResults(in, results[i]);
+    }
+  });
+
+  unordered_set<const Function *> missed;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    if (!cached[i]) {
+      missed.insert(functions[i]);
+    }
+  }
+  LOG(INFO) << "Cached bugs for " << functions.size() - missed.size()
+            << " of " << functions.size() << " functions";
+
+  errspec::FunctionScope scope;
+  scope.restrictTo(
+      [&missed](const Function &F) { return missed.count(&F) > 0; });
+
+  legacy::PassManager PM;
+  PM.add(new ErrorModels(config.models));
+  ReturnPropagationPointer *return_propagation =
+      new ReturnPropagationPointer(config.debug_function, jobs);
+  ReturnConstraintsPointer *return_constraints =
+      new ReturnConstraintsPointer(jobs);
+  MissingChecks *missing_checks = new MissingChecks(
+      specs, config.error_only, config.debug_function, jobs);
+  return_constraints->retention.keepBoundariesOnly();
+  return_propagation->scope = scope;
+  return_constraints->scope = scope;
+  missing_checks->scope = scope;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    if (cached[i]) {
+      missing_checks->cached_results[functions[i]] = results[i];
+    }
+  }
+  missing_checks->output = &out;
+  PM.add(return_propagation);
+  PM.add(return_constraints);
+  PM.add(missing_checks);
   PM.run(Mod);
 
+  for (size_t i = 0; i < functions.size(); ++i) {
+    if (cached[i]) {
+      continue;
+    }
+    ostringstream entry;
+    MissingChecks::writeResults(missing_checks->getResults(*functions[i]),
+                                entry);
+    cache.store("bugs", keys[i], entry.str());
+  }
+}
+
+// Like analyze, but the functions whose results are in the cache are not
+// analyzed again. Specifications are linked from the function summaries (see
+// ErrorSummary.h) instead of being inferred by ErrorBlocks.
+void analyzeCached(Module &Mod, const vector<string> &commands,
+                   const vector<ostream *> &outputs,
+                   const AnalysisConfig &config, unsigned jobs) {
+  auto requested = [&](const string &cmd) {
+    return find(commands.begin(), commands.end(), cmd) != commands.end();
+  };
+  bool infer = requested("specs");
+
+  vector<Function *> functions;
+  for (Function &F : Mod) {
+    if (!F.isDeclaration()) {
+      functions.push_back(&F);
+    }
+  }
+
+  // Every key covers the cache format, the error-only functions, the error
+  // models and the error codes of the module
+  vector<string> config_parts(config.error_only.begin(),
+                              config.error_only.end());
+  std::sort(config_parts.begin(), config_parts.end());
+  config_parts.insert(config_parts.begin(), CACHE_VERSION);
+  errspec::ErrorCodeClassifier error_codes(config.error_codes, &Mod);
+  for (const string &line : formatTables(config, error_codes)) {
+    config_parts.push_back(line);
+  }
+  string config_key = errspec::hashStrings(config_parts);
+
+  vector<string> keys(functions.size());
+  errspec::parallelFor(jobs, functions.size(), [&](size_t i) {
+    keys[i] = errspec::hashStrings(
+        {config_key, errspec::hashFunction(*functions[i])});
+  });
+
+  vector<errspec::FunctionSummary> summaries;
+  errspec::LinkedSpecs linked;
+  if (infer || requested("summary")) {
+    summaries = cachedSummaries(Mod, functions, keys, config, jobs);
+  }
+  if (infer) {
+    linked = errspec::linkSummaries(summaries, config.input_specs);
+  }
+
+  for (size_t i = 0; i < commands.size(); ++i) {
+    if (commands[i] == "specs") {
+      printSpecs(linked.specs, config.binary_specs, *outputs[i]);
+    } else if (commands[i] == "summary") {
+      printSummaries(summaries, *outputs[i]);
+    } else if (commands[i] == "bugs") {
+      cachedBugs(Mod, functions, keys,
+                 infer                   ? linked.specs
+                 : config.specs_snapshot ? config.specs_snapshot->toMap()
+                                         : config.specs,
+                 config, jobs, *outputs[i]);
+    }
+  }
+}
+
+void printFullPropagation(ReturnedValues &returned_values, ostream &out) {
   unordered_map<string, Constraint> propagated_specs;
 
   unordered_map<llvm::Function *, unordered_set<string>> return_propagated =
-      returned_values->getReturnPropagation();
+      returned_values.getReturnPropagation();
 
-  cout << "digraph full_prop {\n";
+  out << "digraph full_prop {\n";
   for (const auto &rp : return_propagated) {
     llvm::Function *f = rp.first;
     string fname = f->getName();
@@ -183,105 +1100,177 @@ void fullpropagation(Module &Mod, string error_only_path) {
         continue;
       }
 
-      cout << "\"" << v << "(" << vc.interval << ")\" -> \"" << fname << "("
-           << fc.interval << ")\""
-           << "\n";
+      out << "\"" << v << "(" << vc.interval << ")\" -> \"" << fname << "("
+          << fc.interval << ")\""
+          << "\n";
     }
   }
-  cout << "}\n";
+  out << "}\n";
 }
 
-void specs(Module &Mod, string error_only_path, string input_specs_path) {
-  legacy::PassManager PM;
-  ReturnPropagation *return_propagation = new ReturnPropagation();
-  ReturnConstraints *return_constraints = new ReturnConstraints();
-  ErrorBlocks *error_blocks =
-      new ErrorBlocks(error_only_path, input_specs_path);
-  ReturnedValues *returned_values = new ReturnedValues();
-  PM.add(return_propagation);
-  PM.add(return_constraints);
-  PM.add(error_blocks);
-  PM.add(returned_values);
-  PM.run(Mod);
+void printSpecs(const unordered_map<string, Constraint> &specs, bool binary,
+                ostream &out) {
+  if (binary) {
+    errspec::writeSpecSnapshot(specs, out);
+    return;
+  }
 
-  unordered_map<string, Constraint> abstract_error_return_values =
-      error_blocks->getErrorReturnValues();
+  // Sorted by name so that the output does not depend on the order in
+  // which the specs were found
+  map<string, Constraint> abstract_error_return_values(specs.begin(),
+                                                       specs.end());
 
   // Print specs
   for (const auto &kv : abstract_error_return_values) {
     string fname = kv.first;
     Constraint aerv = kv.second;
-    cout << fname << ": " << aerv;
-    cout << endl;
+    out << fname << ": " << aerv;
+    out << endl;
   }
 }
 
 // The constant values that each function can return
-void errorpropagation(Module &Mod, string error_only_path,
-                      string input_specs_path) {
-  legacy::PassManager PM;
-  ReturnPropagation *return_propagation = new ReturnPropagation();
-  ReturnConstraints *return_constraints = new ReturnConstraints();
-  ErrorBlocks *error_blocks =
-      new ErrorBlocks(error_only_path, input_specs_path);
-  ReturnedValues *returned_values = new ReturnedValues();
-  PM.add(return_propagation);
-  PM.add(return_constraints);
-  PM.add(error_blocks);
-  PM.add(returned_values);
-  PM.run(Mod);
-
-  // Returned values
-  unordered_map<string, Constraint> abstract_error_return_values =
-      error_blocks->getErrorReturnValues();
-
+void printErrorPropagation(const set<ErrorPropagationEdge> &error_propagation,
+                           const unordered_set<string> &error_only_bootstrap,
+                           const unordered_map<string, Constraint> &specs,
+                           ostream &out) {
   // Print error propagation graph
-  cout << "digraph error_prop {\n";
-  for (const auto &erp : error_blocks->error_propagation) {
+  out << "digraph error_prop {\n";
+  for (const auto &erp : error_propagation) {
     string from_name = erp.first;
     string to_name = erp.second;
-    auto &bootstrap = error_blocks->error_only_bootstrap;
-    Constraint from_spec = error_blocks->getAERV(from_name);
-    Constraint to_spec = error_blocks->getAERV(to_name);
+    auto &bootstrap = error_only_bootstrap;
+    Constraint from_spec = specs.at(from_name);
+    Constraint to_spec = specs.at(to_name);
     if (bootstrap.find(from_name) != bootstrap.end()) {
       from_name = from_name + "(EO)";
     }
     if (bootstrap.find(to_name) != bootstrap.end()) {
       to_name = to_name + "(EO)";
     }
-    cout << "\"" << from_name << " " << from_spec.interval << "\""
-         << " -> \"" << to_name << " " << to_spec.interval << "\""
-         << "\n";
+    out << "\"" << from_name << " " << from_spec.interval << "\""
+        << " -> \"" << to_name << " " << to_spec.interval << "\""
+        << "\n";
   }
-  cout << "}\n";
+  out << "}\n";
 
   return;
 }
 
-void bugs(Module &Mod, string specs_path, string error_only_path, string debug_function) {
-  legacy::PassManager PM;
+// Functions with nothing to summarize are left out
+void printSummaries(const vector<errspec::FunctionSummary> &summaries,
+                    ostream &out) {
+  vector<errspec::FunctionSummary> nonempty;
+  for (const errspec::FunctionSummary &summary : summaries) {
+    if (!summary.empty()) {
+      nonempty.push_back(summary);
+    }
+  }
+  errspec::writeSummaries(nonempty, out);
+}
+
+// The summaries of the modules of a batch, or of separate runs, are linked
+// into one program: functions with the same name are merged.
+bool link(const vector<string> &summary_paths, const vector<string> &commands,
+          const vector<ostream *> &outputs, string input_specs_path,
+          bool binary_specs) {
+  vector<errspec::FunctionSummary> summaries;
+  for (const string &path : summary_paths) {
+    ifstream summary_file(path);
+    if (!summary_file) {
+      cerr << "FATAL: Cannot open summary file: " << path << endl;
+      return false;
+    }
+    if (!errspec::readSummaries(summary_file, summaries)) {
+      cerr << "FATAL: Error parsing summary file: " << path << endl;
+      return false;
+    }
+  }
 
-  ReturnPropagationPointer *return_propagation = new ReturnPropagationPointer(debug_function);
-  ReturnConstraintsPointer *return_constraints = new ReturnConstraintsPointer;
-  MissingChecks *missing_checks = new MissingChecks(specs_path, error_only_path, debug_function);
+  unordered_map<string, Constraint> input_specs =
+      errspec::readInputSpecsFile(input_specs_path);
+  if (input_specs.empty()) {
+    LOG(WARNING) << "EMPTY INPUT SPECS LIST!\n";
+  }
 
-  PM.add(return_propagation);
-  PM.add(return_constraints);
-  PM.add(missing_checks);
-  PM.run(Mod);
+  errspec::LinkedSpecs linked = errspec::linkSummaries(summaries, input_specs);
+  LOG(INFO) << "Linked " << summaries.size() << " function summaries";
+
+  for (size_t i = 0; i < commands.size(); ++i) {
+    if (commands[i] == "specs") {
+      printSpecs(linked.specs, binary_specs, *outputs[i]);
+    } else if (commands[i] == "errorpropagation") {
+      printErrorPropagation(linked.error_propagation,
+                            linked.error_only_bootstrap, linked.specs,
+                            *outputs[i]);
+    }
+  }
+  return true;
 }
 
-// Prints a list of functions defined in the bitcode file
-void definedfunctions(Module &Mod) {
-  legacy::PassManager PM;
-  DefinedFunctions *defined_functions = new DefinedFunctions;
-  PM.add(defined_functions);
-  PM.run(Mod);
+// Prints a list of functions defined in the bitcode file. Only the module's
+// headers are read: a function whose body is still in the bitcode is defined.
+bool definedfunctions(string bitcode_path, ostream &out) {
+  SMDiagnostic Err;
+  LLVMContext Context;
+  unique_ptr<Module> Mod(
+      getLazyIRFileModule(bitcode_path, Err, Context, true));
+  if (!Mod) {
+    return false;
+  }
+
+  raw_os_ostream os(out);
+  for (const Function &F : *Mod) {
+    if (!F.isDeclaration()) {
+      DefinedFunctions::print(F, os);
+    }
+  }
+  return true;
 }
 
-void calledfunctions(Module &Mod) {
-  legacy::PassManager PM;
-  CalledFunctions *called_functions = new CalledFunctions;
-  PM.add(called_functions);
-  PM.run(Mod);
+// Prints the callee of every call in the bitcode file. With aggregate, prints
+// one line per directly called function instead: its name, the number of
+// calls to it and the number of functions that call it, sorted by name.
+// Bodies are read one at a time and dropped as soon as they are scanned.
+bool calledfunctions(string bitcode_path, bool aggregate, ostream &out) {
+  struct CallCounts {
+    uint64_t calls = 0;
+    uint64_t callers = 0;
+  };
+  map<string, CallCounts> counts;
+
+  auto scan = [&](const Function &F) {
+    vector<string> callees = CalledFunctions::getCallees(F);
+    if (!aggregate) {
+      for (const string &fname : callees) {
+        out << fname << "\n";
+      }
+      return false;
+    }
+
+    unordered_set<string> called;
+    for (const string &fname : callees) {
+      if (fname.empty()) {
+        continue;
+      }
+      CallCounts &c = counts[fname];
+      ++c.calls;
+      if (called.insert(fname).second) {
+        ++c.callers;
+      }
+    }
+    return false;
+  };
+
+  SMDiagnostic Err;
+  LLVMContext Context;
+  if (!errspec::loadModuleLazily(bitcode_path, Err, Context, scan)) {
+    return false;
+  }
+
+  for (const auto &kv : counts) {
+    out << kv.first << " " << kv.second.calls << " " << kv.second.callers
+        << "\n";
+  }
+  return true;
 }
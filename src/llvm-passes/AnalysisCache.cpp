@@ -0,0 +1,156 @@
+#include "AnalysisCache.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/raw_ostream.h"
+#include <fstream>
+#include <sstream>
+
+using namespace llvm;
+using namespace std;
+
+namespace errspec {
+
+AnalysisCache::AnalysisCache(const string &dir) : dir(dir) {
+  sys::fs::create_directories(dir);
+}
+
+bool AnalysisCache::lookup(const string &kind, const string &key,
+                           string &value) const {
+  ifstream entry(dir + "/" + kind + "/" + key);
+  if (!entry) {
+    return false;
+  }
+  ostringstream contents;
+  contents << entry.rdbuf();
+  value = contents.str();
+  return true;
+}
+
+void AnalysisCache::store(const string &kind, const string &key,
+                          const string &value) const {
+  string kind_dir = dir + "/" + kind;
+  sys::fs::create_directories(kind_dir);
+
+  int fd;
+  SmallString<128> tmp_path;
+  if (sys::fs::createUniqueFile(kind_dir + "/.tmp-%%%%%%%%", fd, tmp_path)) {
+    return;
+  }
+  {
+    raw_fd_ostream tmp(fd, true);
+    tmp << value;
+  }
+  if (sys::fs::rename(tmp_path, kind_dir + "/" + key)) {
+    sys::fs::remove(tmp_path);
+  }
+}
+
+// Writes a description of v that only depends on F: local values by number,
+// globals by name and other constants as printed. Unnamed globals have no
+// name to tell them apart and print as their slot in the module, @0, @1...
+static void describeOperand(const Value *v,
+                            const DenseMap<const Value *, unsigned> &local_ids,
+                            raw_ostream &os) {
+  auto local = local_ids.find(v);
+  if (local != local_ids.end()) {
+    os << "%" << local->second;
+  } else if (isa<GlobalValue>(v) && !v->hasName()) {
+    v->printAsOperand(os, false);
+  } else if (const GlobalValue *global = dyn_cast<GlobalValue>(v)) {
+    os << "@" << global->getName();
+  } else if (isa<MetadataAsValue>(v)) {
+    os << "metadata";
+  } else if (const InlineAsm *inline_asm = dyn_cast<InlineAsm>(v)) {
+    os << "asm " << inline_asm->getAsmString();
+  } else {
+    v->printAsOperand(os, true);
+  }
+}
+
+// Writes what I holds besides its operands: the indices of aggregate
+// instructions and the types that GEPs and allocas are over
+static void describePayload(const Instruction &I, raw_ostream &os) {
+  ArrayRef<unsigned> indices;
+  if (const ExtractValueInst *extract = dyn_cast<ExtractValueInst>(&I)) {
+    indices = extract->getIndices();
+  } else if (const InsertValueInst *insert = dyn_cast<InsertValueInst>(&I)) {
+    indices = insert->getIndices();
+  } else if (const GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(&I)) {
+    os << " ";
+    gep->getSourceElementType()->print(os);
+  } else if (const AllocaInst *alloca = dyn_cast<AllocaInst>(&I)) {
+    os << " ";
+    alloca->getAllocatedType()->print(os);
+  }
+  for (unsigned index : indices) {
+    os << " " << index;
+  }
+}
+
+string hashFunction(const Function &F) {
+  DenseMap<const Value *, unsigned> local_ids;
+  for (const Argument &arg : F.args()) {
+    local_ids.insert(make_pair(&arg, local_ids.size()));
+  }
+  for (const BasicBlock &BB : F) {
+    local_ids.insert(make_pair(&BB, local_ids.size()));
+    for (const Instruction &I : BB) {
+      local_ids.insert(make_pair(&I, local_ids.size()));
+    }
+  }
+
+  string text;
+  raw_string_ostream os(text);
+  os << F.getName() << " ";
+  F.getFunctionType()->print(os);
+  for (const BasicBlock &BB : F) {
+    os << "\n%" << local_ids.lookup(&BB) << ":";
+    for (const Instruction &I : BB) {
+      os << "\n" << I.getOpcodeName() << " ";
+      I.getType()->print(os);
+      if (const CmpInst *cmp = dyn_cast<CmpInst>(&I)) {
+        os << " " << static_cast<unsigned>(cmp->getPredicate());
+      }
+      describePayload(I, os);
+      for (const Use &op : I.operands()) {
+        os << ", ";
+        describeOperand(op.get(), local_ids, os);
+      }
+      if (const PHINode *phi = dyn_cast<PHINode>(&I)) {
+        for (const BasicBlock *incoming : phi->blocks()) {
+          os << ", %" << local_ids.lookup(incoming);
+        }
+      }
+      if (const DILocation *loc = I.getDebugLoc()) {
+        os << " !" << loc->getFilename() << ":" << loc->getLine() << ":"
+           << loc->getColumn();
+      }
+    }
+  }
+  os.flush();
+
+  MD5 md5;
+  md5.update(text);
+  MD5::MD5Result result;
+  md5.final(result);
+  return result.digest().str();
+}
+
+string hashStrings(const vector<string> &parts) {
+  MD5 md5;
+  for (const string &part : parts) {
+    md5.update(part);
+    md5.update(StringRef("\0", 1));
+  }
+  MD5::MD5Result result;
+  md5.final(result);
+  return result.digest().str();
+}
+
+} // namespace errspec
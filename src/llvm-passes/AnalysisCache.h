@@ -0,0 +1,48 @@
+// An on-disk cache of per-function analysis results, for runs over bitcode
+// that changed little since the last run.
+//
+// Entries are keyed by a hash of everything the result depends on: the IR of
+// the function (see hashFunction), the configuration and, for results that
+// read specifications, the specifications of its callees. A function whose
+// key is found is not analyzed again.
+//
+// Each entry is one file, DIR/KIND/KEY. An entry is written to a temporary
+// file in the same directory and renamed into place, so processes and
+// threads sharing the directory only ever see complete entries. When two of
+// them store the same key, the entries are identical and either one wins.
+
+#ifndef ANALYSISCACHE_H
+#define ANALYSISCACHE_H
+
+#include "llvm/IR/Function.h"
+#include <string>
+#include <vector>
+
+namespace errspec {
+
+class AnalysisCache {
+public:
+  // Creates dir if it does not exist
+  explicit AnalysisCache(const std::string &dir);
+
+  bool lookup(const std::string &kind, const std::string &key,
+              std::string &value) const;
+  void store(const std::string &kind, const std::string &key,
+             const std::string &value) const;
+
+private:
+  std::string dir;
+};
+
+// Hash of the IR of F: its name and type, and the opcode, types, operands,
+// predicates, aggregate indices, GEP and alloca types and debug locations of
+// its instructions. Values local to F are numbered in order and globals are
+// named, so the hash does not change when other functions of the module do.
+std::string hashFunction(const llvm::Function &F);
+
+// Hash of the concatenation of parts, with a separator between them
+std::string hashStrings(const std::vector<std::string> &parts);
+
+} // namespace errspec
+
+#endif
@@ -0,0 +1,122 @@
+#include "CallGraphSCCs.h"
+#include "Common.h"
+#include "llvm/IR/Instructions.h"
+#include <algorithm>
+#include <utility>
+
+using namespace llvm;
+using namespace std;
+
+namespace errspec {
+
+CallGraphSCCs::CallGraphSCCs(Module &M) {
+  buildEdges(M);
+  computeSCCs(M);
+}
+
+const unordered_set<Function *> &
+CallGraphSCCs::getCallers(const string &fname) const {
+  auto it = callers.find(fname);
+  if (it == callers.end()) {
+    return no_callers;
+  }
+  return it->second;
+}
+
+void CallGraphSCCs::buildEdges(Module &M) {
+  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
+    Function *F = &*fi;
+    if (F->isDeclaration()) {
+      continue;
+    }
+
+    unordered_set<Function *> seen;
+    vector<Function *> &f_callees = callees[F];
+    for (auto bi = F->begin(), be = F->end(); bi != be; ++bi) {
+      for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
+        CallInst *call = dyn_cast<CallInst>(&*ii);
+        if (!call) {
+          continue;
+        }
+        string callee_name = getCalleeName(*call);
+        if (callee_name.empty()) {
+          continue;
+        }
+        callers[callee_name].insert(F);
+
+        Function *callee = M.getFunction(callee_name);
+        if (callee && !callee->isDeclaration() && seen.insert(callee).second) {
+          f_callees.push_back(callee);
+        }
+      }
+    }
+  }
+}
+
+// Iterative Tarjan. An SCC is completed only after every SCC reachable
+// from it, so completion order is bottom-up.
+void CallGraphSCCs::computeSCCs(Module &M) {
+  unordered_map<Function *, unsigned> dfs_index;
+  unordered_map<Function *, unsigned> lowlink;
+  vector<Function *> scc_stack;
+  unordered_set<Function *> on_stack;
+
+  // Nodes currently being explored and the next callee to look at
+  vector<pair<Function *, unsigned>> dfs_stack;
+  unsigned next_index = 0;
+
+  auto discover = [&](Function *F) {
+    dfs_index[F] = next_index;
+    lowlink[F] = next_index;
+    ++next_index;
+    scc_stack.push_back(F);
+    on_stack.insert(F);
+    dfs_stack.push_back(make_pair(F, 0u));
+  };
+
+  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
+    Function *root = &*fi;
+    if (root->isDeclaration() || dfs_index.count(root)) {
+      continue;
+    }
+
+    discover(root);
+    while (!dfs_stack.empty()) {
+      Function *F = dfs_stack.back().first;
+      const vector<Function *> &f_callees = callees.at(F);
+
+      if (dfs_stack.back().second < f_callees.size()) {
+        Function *callee = f_callees[dfs_stack.back().second++];
+        if (!dfs_index.count(callee)) {
+          discover(callee);
+        } else if (on_stack.count(callee)) {
+          lowlink[F] = min(lowlink[F], dfs_index[callee]);
+        }
+        continue;
+      }
+
+      if (lowlink[F] == dfs_index[F]) {
+        vector<Function *> scc;
+        Function *member;
+        do {
+          member = scc_stack.back();
+          scc_stack.pop_back();
+          on_stack.erase(member);
+          scc_index[member] = sccs.size();
+          scc.push_back(member);
+        } while (member != F);
+        // Members in discovery order
+        reverse(scc.begin(), scc.end());
+        sccs.push_back(scc);
+      }
+
+      dfs_stack.pop_back();
+      if (!dfs_stack.empty()) {
+        Function *parent = dfs_stack.back().first;
+        lowlink[parent] = min(lowlink[parent], lowlink[F]);
+      }
+    }
+  }
+}
+
+} // namespace errspec
@@ -0,0 +1,56 @@
+// Strongly connected components of the call graph of a module, ordered
+// bottom-up: every SCC appears after all of the SCCs it calls into.
+//
+// Calls are resolved by name with getCalleeName, the same way the passes key
+// specifications, so calls through pointer casts are edges too. Only defined
+// functions are nodes. Indirect calls are not edges.
+
+#ifndef CALLGRAPHSCCS_H
+#define CALLGRAPHSCCS_H
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace errspec {
+
+class CallGraphSCCs {
+public:
+  explicit CallGraphSCCs(llvm::Module &M);
+
+  // SCCs with callees before callers
+  const std::vector<std::vector<llvm::Function *>> &getSCCs() const {
+    return sccs;
+  }
+
+  // Position of the SCC containing F in getSCCs()
+  unsigned getSCCIndex(llvm::Function *F) const { return scc_index.at(F); }
+
+  // Defined functions that contain a call to fname
+  const std::unordered_set<llvm::Function *> &
+  getCallers(const std::string &fname) const;
+
+  // Defined functions called directly by F
+  const std::vector<llvm::Function *> &getCallees(llvm::Function *F) const {
+    return callees.at(F);
+  }
+
+private:
+  void buildEdges(llvm::Module &M);
+  void computeSCCs(llvm::Module &M);
+
+  std::vector<std::vector<llvm::Function *>> sccs;
+  std::unordered_map<llvm::Function *, unsigned> scc_index;
+  std::unordered_map<std::string, std::unordered_set<llvm::Function *>>
+      callers;
+  std::unordered_map<llvm::Function *, std::vector<llvm::Function *>> callees;
+
+  const std::unordered_set<llvm::Function *> no_callers;
+};
+
+} // namespace errspec
+
+#endif
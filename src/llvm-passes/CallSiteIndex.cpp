@@ -0,0 +1,85 @@
+#include "CallSiteIndex.h"
+#include "Common.h"
+#include "InstructionNumbering.h"
+#include <algorithm>
+
+using namespace llvm;
+using namespace std;
+using namespace errspec;
+
+bool CallSiteIndex::runOnModule(Module &M) {
+  InstructionNumbering &numbering = getAnalysis<InstructionNumbering>();
+  ErrorModels &models = getAnalysis<ErrorModels>();
+
+  // Ids are handed out in module order. Instructions are visited in
+  // numbering order, so every list comes out sorted.
+  function_ids = FunctionIds();
+  call_sites.clear();
+  calls.clear();
+  for (Function &F : M) {
+    for (BasicBlock &BB : F) {
+      for (Instruction &I : BB) {
+        if (CallInst *call = dyn_cast<CallInst>(&I)) {
+          const Function *callee =
+              dyn_cast<Function>(call->getCalledValue()->stripPointerCasts());
+          CallInfo info = {callee, function_ids.intern(getCalleeName(*call)),
+                           models.getModel(callee)};
+          calls[call] = info;
+          if (info.id == call_sites.size()) {
+            call_sites.emplace_back();
+          }
+          CallSite site = {numbering.getNumber(call), call};
+          call_sites[info.id].push_back(site);
+        }
+      }
+    }
+  }
+  callee_flags.assign(function_ids.size(), 0);
+
+  return false;
+}
+
+const CallSiteIndex::CallInfo &
+CallSiteIndex::getCallInfo(const CallInst &call) const {
+  auto it = calls.find(&call);
+  assert(it != calls.end() && "call not in the indexed module");
+  return it->second;
+}
+
+void CallSiteIndex::markCallees(
+    CalleeFlag flag, const function<bool(const string &)> &marked) {
+  for (FunctionId id = 0; id < function_ids.size(); ++id) {
+    if (marked(function_ids.getName(id))) {
+      callee_flags[id] |= flag;
+    } else {
+      callee_flags[id] &= ~flag;
+    }
+  }
+}
+
+void CallSiteIndex::markCallees(CalleeFlag flag,
+                                const unordered_set<string> &names) {
+  markCallees(flag,
+              [&names](const string &name) { return names.count(name) > 0; });
+}
+
+bool CallSiteIndex::hasCallBetween(FunctionId callee, unsigned first,
+                                   unsigned last) const {
+  const vector<CallSite> &sites = getCallSites(callee);
+  auto it = lower_bound(sites.begin(), sites.end(), first,
+                        [](const CallSite &site, unsigned number) {
+                          return site.number < number;
+                        });
+  return it != sites.end() && it->number <= last;
+}
+
+void CallSiteIndex::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<InstructionNumbering>();
+  AU.addRequired<ErrorModels>();
+  AU.setPreservesAll();
+}
+
+char CallSiteIndex::ID = 0;
+static RegisterPass<CallSiteIndex>
+    X("call-site-index", "Calls to each callee sorted by instruction number",
+      false, true);
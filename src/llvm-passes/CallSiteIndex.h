@@ -0,0 +1,93 @@
+// The call sites of every callee in a module.
+//
+// Callees are identified by their FunctionId, and the ids are shared by every
+// pass that requires this analysis, so facts computed by one pass can be
+// matched against the index without going back to names. The calls to each
+// callee are kept sorted by instruction number (see InstructionNumbering),
+// which makes "is there a call to f in this range of instructions" a binary
+// search instead of a scan of the module.
+//
+// Every call is also resolved once to its callee, id and error model (see
+// ErrorModels.h), so the transfer functions do not go back to the name of the
+// callee. Passes mark the callees they look names up for, such as error-only
+// functions and functions with a spec, and then test a bit per call.
+
+#ifndef CALLSITEINDEX_H
+#define CALLSITEINDEX_H
+
+#include "ErrorModels.h"
+#include "FunctionIds.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+class CallSiteIndex : public llvm::ModulePass {
+public:
+  static char ID;
+
+  struct CallSite {
+    unsigned number;
+    llvm::CallInst *call;
+  };
+
+  // What a call resolves to
+  struct CallInfo {
+    // Null for indirect calls
+    const llvm::Function *callee;
+    errspec::FunctionId id;
+    errspec::ModelKind model;
+  };
+
+  // Marks of callees, by id
+  enum CalleeFlag : uint8_t { ErrorOnly = 1, HasSpec = 2 };
+
+  CallSiteIndex() : llvm::ModulePass(ID) {}
+
+  bool runOnModule(llvm::Module &M) override;
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  // Names of the callees of the module by id
+  const errspec::FunctionIds &getFunctionIds() const { return function_ids; }
+
+  // The calls to callee in module order
+  const std::vector<CallSite> &getCallSites(errspec::FunctionId callee) const {
+    return call_sites.at(callee);
+  }
+
+  const CallInfo &getCallInfo(const llvm::CallInst &call) const;
+
+  // Sets flag on exactly the callees whose names satisfy marked. Passes mark
+  // callees in runOnModule, before they test the flag.
+  void markCallees(CalleeFlag flag,
+                   const std::function<bool(const std::string &)> &marked);
+  void markCallees(CalleeFlag flag,
+                   const std::unordered_set<std::string> &names);
+
+  bool hasFlag(errspec::FunctionId callee, CalleeFlag flag) const {
+    return callee_flags[callee] & flag;
+  }
+  bool hasFlag(const llvm::CallInst &call, CalleeFlag flag) const {
+    return hasFlag(getCallInfo(call).id, flag);
+  }
+
+  // True if a call to callee is numbered between first and last inclusive
+  bool hasCallBetween(errspec::FunctionId callee, unsigned first,
+                      unsigned last) const;
+
+private:
+  errspec::FunctionIds function_ids;
+
+  // By callee id
+  std::vector<std::vector<CallSite>> call_sites;
+  std::vector<uint8_t> callee_flags;
+
+  llvm::DenseMap<const llvm::CallInst *, CallInfo> calls;
+};
+
+#endif
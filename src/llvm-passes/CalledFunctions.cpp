@@ -18,19 +18,24 @@ bool CalledFunctions::runOnFunction(Function &F) {
   // This is a function pass not a module pass.
   // we don't need to explicitly strip out intrinsics or declarations.
 
-  for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
-    BasicBlock *bb = &*bi;
-    for (auto ii = bb->begin(), ie = bb->end(); ii != ie; ++ii) {
-      Instruction *i = &*ii;
+  // One line per call, flushed once at the end rather than per line
+  for (const string &fname : getCallees(F)) {
+    cout << fname << "\n";
+  }
+
+  return false;
+}
 
-      if (CallInst *call = dyn_cast<CallInst>(i)) {
-        string fname = getCalleeName(*call);
-        cout << fname << endl;
+vector<string> CalledFunctions::getCallees(const Function &F) {
+  vector<string> callees;
+  for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
+    for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
+      if (const CallInst *call = dyn_cast<CallInst>(&*ii)) {
+        callees.push_back(getCalleeName(*call));
       }
     }
   }
-
-  return false;
+  return callees;
 }
 
 std::unordered_set<string> CalledFunctions::getCalledFunctions() {
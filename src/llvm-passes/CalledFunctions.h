@@ -3,6 +3,7 @@
 
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include "llvm/Pass.h"
 #include "llvm/IR/Function.h"
@@ -17,6 +18,10 @@ struct CalledFunctions : public llvm::FunctionPass {
   bool runOnFunction(llvm::Function &F) override;
   std::unordered_set<std::string> getCalledFunctions();
 
+  // The callee of every call in F, in order. Indirect calls have an empty
+  // name.
+  static std::vector<std::string> getCallees(const llvm::Function &F);
+
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
 
  private:
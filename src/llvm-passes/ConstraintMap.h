@@ -0,0 +1,142 @@
+// The constraints that reaching branches place on the return values of called
+// functions, as a flat vector of (FunctionId, Interval) sorted by id.
+//
+// The vector is copy-on-write. Copying a map shares the vector and a map
+// only clones it when an update really changes an interval, so the facts of
+// a run of instructions that do not touch the constraints point to the same
+// storage and comparing them is a pointer comparison. Maps may be read from
+// any thread but must be updated by the one thread that owns the facts they
+// belong to.
+
+#ifndef CONSTRAINTMAP_H
+#define CONSTRAINTMAP_H
+
+#include "FunctionIds.h"
+#include "Interval.h"
+#include "llvm/ADT/SmallVector.h"
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+namespace errspec {
+
+class ConstraintMap {
+public:
+  typedef std::pair<FunctionId, Interval> Entry;
+  typedef llvm::SmallVector<Entry, 8> Entries;
+  typedef Entries::const_iterator const_iterator;
+
+  const_iterator begin() const { return items().begin(); }
+  const_iterator end() const { return items().end(); }
+  size_t size() const { return items().size(); }
+  bool empty() const { return items().empty(); }
+
+  // The interval of id, or nullptr if id is not constrained
+  const Interval *lookup(FunctionId id) const {
+    auto it = lowerBound(id);
+    if (it == items().end() || it->first != id) {
+      return nullptr;
+    }
+    return &it->second;
+  }
+
+  void set(FunctionId id, Interval interval) {
+    size_t pos = lowerBound(id) - items().begin();
+    if (pos != size() && items()[pos].first == id) {
+      if (items()[pos].second != interval) {
+        mutableItems()[pos].second = interval;
+      }
+    } else {
+      Entries &mutable_items = mutableItems();
+      mutable_items.insert(mutable_items.begin() + pos, Entry(id, interval));
+    }
+  }
+
+  // Constrains every function constrained by either map. Functions
+  // constrained by both get the join of the two intervals.
+  void join(const ConstraintMap &other) {
+    if (entries == other.entries || other.empty()) {
+      return;
+    }
+    if (empty()) {
+      entries = other.entries;
+      return;
+    }
+
+    std::shared_ptr<Entries> merged = std::make_shared<Entries>();
+    merged->reserve(size() + other.size());
+    auto a = begin(), ae = end();
+    auto b = other.begin(), be = other.end();
+    while (a != ae || b != be) {
+      if (b == be || (a != ae && a->first < b->first)) {
+        merged->push_back(*a++);
+      } else if (a == ae || b->first < a->first) {
+        merged->push_back(*b++);
+      } else {
+        merged->push_back(Entry(a->first, joinIntervals(a->second, b->second)));
+        ++a;
+        ++b;
+      }
+    }
+
+    // Keep sharing the old vector if other added nothing
+    if (*merged != items()) {
+      entries = std::move(merged);
+    }
+  }
+
+  // Adds the constraints in other. Functions constrained by both get the
+  // meet of the two intervals. Returns true if this map changed.
+  bool meet(const ConstraintMap &other) {
+    if (entries == other.entries) {
+      return false;
+    }
+    bool changed = false;
+    for (const Entry &entry : other) {
+      const Interval *current = lookup(entry.first);
+      Interval met =
+          current ? meetIntervals(*current, entry.second) : entry.second;
+      if (!current || met != *current) {
+        set(entry.first, met);
+        changed = true;
+      }
+    }
+    return changed;
+  }
+
+  bool operator==(const ConstraintMap &other) const {
+    return entries == other.entries || items() == other.items();
+  }
+  bool operator!=(const ConstraintMap &other) const {
+    return !(*this == other);
+  }
+
+private:
+  // Null for the empty map
+  std::shared_ptr<Entries> entries;
+
+  const Entries &items() const {
+    static const Entries no_entries;
+    return entries ? *entries : no_entries;
+  }
+
+  // Clones the vector first if another map shares it
+  Entries &mutableItems() {
+    if (!entries) {
+      entries = std::make_shared<Entries>();
+    } else if (entries.use_count() > 1) {
+      entries = std::make_shared<Entries>(*entries);
+    }
+    return *entries;
+  }
+
+  const_iterator lowerBound(FunctionId id) const {
+    return std::lower_bound(
+        items().begin(), items().end(), id,
+        [](const Entry &entry, FunctionId id) { return entry.first < id; });
+  }
+};
+
+} // namespace errspec
+
+#endif
@@ -0,0 +1,403 @@
+// A worklist solver for the intraprocedural dataflow passes.
+//
+// The passes keep their facts in two FactTables, input_facts and
+// output_facts, indexed by instruction number. The solver owns the iteration
+// order: blocks are seeded in reverse post-order (forward analyses) or
+// post-order (backward analyses), or in layout order if the pass asks for it,
+// and a block is only revisited when one of its neighbors reported a change.
+//
+// Template parameters
+// --------------------
+// Dir: Forward joins the exit facts of predecessors into the entry fact of a
+//      block. Backward joins the entry facts of successors into its exit fact.
+// FactT: the lattice. Must provide join(const FactT &).
+// TransferT: callable as bool(llvm::BasicBlock &). Applies the transfer
+//            functions of the block and returns true if anything a neighbor
+//            can observe changed: the block's boundary fact in the direction
+//            of the analysis, or a fact the block wrote into a neighbor.
+//
+// Functions share no facts. Once initFacts has sized the tables of a module
+// they do not change shape and each function only writes the slots of its
+// own instructions, so solveFunctions can solve different functions on
+// different threads.
+
+#ifndef DATAFLOW_HPP
+#define DATAFLOW_HPP
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "InstructionNumbering.h"
+#include "Parallel.hpp"
+#include <functional>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace errspec {
+
+enum class Direction { Forward, Backward };
+
+// The order blocks are seeded and picked from the worklist in. Layout is the
+// order of the blocks in the function, for passes whose results depend on
+// the order in which blocks are first visited.
+enum class BlockOrder { Priority, Layout };
+
+// Counters reported by the passes after they finish a module
+struct DataflowStats {
+  uint64_t blocks = 0;
+  uint64_t visits = 0;
+
+  DataflowStats &operator+=(const DataflowStats &other) {
+    blocks += other.blocks;
+    visits += other.visits;
+    return *this;
+  }
+};
+
+// The facts of a pass on one side of every instruction of a module, in a
+// vector indexed by InstructionNumbering
+template <class FactT> class FactTable {
+public:
+  void init(const InstructionNumbering &numbering) {
+    this->numbering = &numbering;
+    facts.assign(numbering.numInstructions(), nullptr);
+  }
+
+  const InstructionNumbering &getNumbering() const { return *numbering; }
+
+  // True if v is an instruction of the module
+  bool contains(const llvm::Value *v) const { return numbering->contains(v); }
+
+  std::shared_ptr<FactT> &at(const llvm::Value *v) {
+    return facts[numbering->getNumber(llvm::cast<llvm::Instruction>(v))];
+  }
+  const std::shared_ptr<FactT> &at(const llvm::Value *v) const {
+    return facts[numbering->getNumber(llvm::cast<llvm::Instruction>(v))];
+  }
+
+  // By instruction number
+  std::shared_ptr<FactT> &operator[](unsigned number) { return facts[number]; }
+  const std::shared_ptr<FactT> &operator[](unsigned number) const {
+    return facts[number];
+  }
+
+private:
+  const InstructionNumbering *numbering = nullptr;
+  std::vector<std::shared_ptr<FactT>> facts;
+};
+
+template <Direction Dir, class FactT, class TransferT>
+class DataflowEngine {
+public:
+  DataflowEngine(FactTable<FactT> &input_facts, FactTable<FactT> &output_facts,
+                 TransferT transfer,
+                 BlockOrder block_order = BlockOrder::Priority)
+      : input_facts(input_facts), output_facts(output_facts),
+        numbering(input_facts.getNumbering()), transfer(transfer),
+        block_order(block_order) {}
+
+  DataflowStats run(llvm::Function &F) {
+    DataflowStats stats;
+    if (F.empty()) {
+      return stats;
+    }
+
+    computeOrder(F);
+    stats.blocks = order.size();
+
+    // Every block is visited at least once
+    std::set<unsigned> worklist;
+    for (unsigned i = 0, e = order.size(); i != e; ++i) {
+      worklist.insert(i);
+    }
+
+    while (!worklist.empty()) {
+      unsigned idx = *worklist.begin();
+      worklist.erase(worklist.begin());
+      llvm::BasicBlock *BB = order[idx];
+
+      joinNeighbors(*BB);
+      ++stats.visits;
+
+      if (!transfer(*BB)) {
+        continue;
+      }
+
+      if (Dir == Direction::Forward) {
+        for (auto si = llvm::succ_begin(BB), se = llvm::succ_end(BB); si != se;
+             ++si) {
+          worklist.insert(index.lookup(*si));
+        }
+      } else {
+        for (auto pi = llvm::pred_begin(BB), pe = llvm::pred_end(BB); pi != pe;
+             ++pi) {
+          worklist.insert(index.lookup(*pi));
+        }
+      }
+    }
+
+    return stats;
+  }
+
+private:
+  FactTable<FactT> &input_facts;
+  FactTable<FactT> &output_facts;
+  const InstructionNumbering &numbering;
+  TransferT transfer;
+  BlockOrder block_order;
+
+  // Blocks in visiting priority order and the reverse mapping
+  std::vector<llvm::BasicBlock *> order;
+  llvm::DenseMap<llvm::BasicBlock *, unsigned> index;
+
+  void computeOrder(llvm::Function &F) {
+    order.clear();
+    index.clear();
+
+    if (block_order == BlockOrder::Priority && Dir == Direction::Forward) {
+      llvm::ReversePostOrderTraversal<llvm::Function *> rpot(&F);
+      for (llvm::BasicBlock *BB : rpot) {
+        addToOrder(BB);
+      }
+    } else if (block_order == BlockOrder::Priority) {
+      for (llvm::BasicBlock *BB : llvm::post_order(&F.getEntryBlock())) {
+        addToOrder(BB);
+      }
+    }
+
+    // Blocks unreachable from the entry still get facts. In layout order,
+    // this adds every block.
+    for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
+      if (index.find(&*bi) == index.end()) {
+        addToOrder(&*bi);
+      }
+    }
+  }
+
+  void addToOrder(llvm::BasicBlock *BB) {
+    index[BB] = order.size();
+    order.push_back(BB);
+  }
+
+  void joinNeighbors(llvm::BasicBlock &BB) {
+    if (Dir == Direction::Forward) {
+      auto bb_in_fact = input_facts[numbering.getFirst(&BB)];
+      for (auto pi = llvm::pred_begin(&BB), pe = llvm::pred_end(&BB); pi != pe;
+           ++pi) {
+        bb_in_fact->join(*output_facts[numbering.getLast(*pi)]);
+      }
+    } else {
+      auto bb_out_fact = output_facts[numbering.getLast(&BB)];
+      for (auto si = llvm::succ_begin(&BB), se = llvm::succ_end(&BB); si != se;
+           ++si) {
+        bb_out_fact->join(*input_facts[numbering.getFirst(*si)]);
+      }
+    }
+  }
+};
+
+// Sizes input_facts and output_facts for every instruction of the numbered
+// module, so that the tables keep their shape while functions are solved on
+// different threads. The facts themselves are created by createFacts when
+// their function is solved.
+template <class FactT>
+void initFacts(const InstructionNumbering &numbering,
+               FactTable<FactT> &input_facts, FactTable<FactT> &output_facts) {
+  input_facts.init(numbering);
+  output_facts.init(numbering);
+}
+
+// Creates an empty fact at every program point of F. The input of the first
+// instruction of a block is a fresh fact; the input of every other
+// instruction is the output of the instruction before it.
+//
+// transparent(I) is true for instructions whose transfer function is the
+// identity. Their input and output are the same fact, so a run of such
+// instructions shares one fact instead of holding a copy each. Terminators
+// always get a separate output so that a block's entry and exit facts are
+// distinct objects and the solver sees changes made by joins.
+template <class FactT, class TransparentT>
+void createFacts(llvm::Function &F, FactTable<FactT> &input_facts,
+                 FactTable<FactT> &output_facts, TransparentT transparent) {
+  const InstructionNumbering &numbering = input_facts.getNumbering();
+  for (llvm::BasicBlock &BB : F) {
+    std::shared_ptr<FactT> prev = std::make_shared<FactT>();
+    unsigned slot = numbering.getFirst(&BB);
+    for (auto ii = BB.begin(), ie = BB.end(); ii != ie; ++ii, ++slot) {
+      input_facts[slot] = prev;
+      if (!ii->isTerminator() && transparent(*ii)) {
+        output_facts[slot] = prev;
+        continue;
+      }
+      prev = std::make_shared<FactT>();
+      output_facts[slot] = prev;
+    }
+  }
+}
+
+// The program points at which a pass keeps its facts once a function is
+// solved. By default every point is kept. After keepBoundariesOnly, only the
+// entry and exit of every block and the points passed to keep survive;
+// facts anywhere else are recomputed by replayFact when asked for.
+class FactRetention {
+public:
+  typedef std::function<bool(const llvm::Instruction &)> Points;
+
+  void keepBoundariesOnly() { keep_all = false; }
+
+  // Consumers declare the interior points they read facts at
+  void keep(Points points) { kept_points.push_back(points); }
+
+  bool keeps(const llvm::Instruction &I) const {
+    if (keep_all || &I == &I.getParent()->front() || I.isTerminator()) {
+      return true;
+    }
+    for (const Points &points : kept_points) {
+      if (points(I)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  bool keep_all = true;
+  std::vector<Points> kept_points;
+};
+
+// The functions a pass solves. By default every function is solved. A
+// function outside the scope gets no facts, so the consumers of the pass
+// must not read them.
+class FunctionScope {
+public:
+  typedef std::function<bool(const llvm::Function &)> Predicate;
+
+  void restrictTo(Predicate predicate) { this->predicate = predicate; }
+
+  bool contains(const llvm::Function &F) const {
+    return !predicate || predicate(F);
+  }
+
+private:
+  Predicate predicate;
+};
+
+// Drops the facts of F at the points that retention does not keep
+template <class FactT>
+void pruneFacts(llvm::Function &F, FactTable<FactT> &input_facts,
+                FactTable<FactT> &output_facts,
+                const FactRetention &retention) {
+  const InstructionNumbering &numbering = input_facts.getNumbering();
+  for (llvm::BasicBlock &BB : F) {
+    unsigned slot = numbering.getFirst(&BB);
+    for (auto ii = BB.begin(), ie = BB.end(); ii != ie; ++ii, ++slot) {
+      if (!retention.keeps(*ii)) {
+        input_facts[slot].reset();
+        output_facts[slot].reset();
+      }
+    }
+  }
+}
+
+// Returns the fact before (input) or after (!input) I. If pruneFacts dropped
+// it, the transfer functions of I's block are replayed from the nearest kept
+// fact. visit(I, in, out) applies the transfer function of one instruction;
+// it writes out for forward analyses and in for backward ones. Only the
+// facts created for the replay are written, so replays may run concurrently.
+template <Direction Dir, class FactT, class VisitT>
+std::shared_ptr<FactT> replayFact(llvm::Instruction &I, bool input,
+                                  const FactTable<FactT> &input_facts,
+                                  const FactTable<FactT> &output_facts,
+                                  VisitT visit) {
+  unsigned slot = input_facts.getNumbering().getNumber(&I);
+  std::shared_ptr<FactT> fact = (input ? input_facts : output_facts)[slot];
+  if (fact) {
+    return fact;
+  }
+
+  // Block entries (forward) and exits (backward) are always kept, so these
+  // walks stop inside the block
+  llvm::BasicBlock::iterator it = I.getIterator();
+  if (Dir == Direction::Forward) {
+    while (!input_facts[slot]) {
+      --it;
+      --slot;
+    }
+    std::shared_ptr<FactT> in = input_facts[slot];
+    for (;; ++it, ++slot) {
+      if (&*it == &I && input) {
+        return in;
+      }
+      std::shared_ptr<FactT> out = output_facts[slot];
+      if (!out) {
+        out = std::make_shared<FactT>();
+        visit(*it, in, out);
+      }
+      if (&*it == &I) {
+        return out;
+      }
+      in = out;
+    }
+  } else {
+    while (!output_facts[slot]) {
+      ++it;
+      ++slot;
+    }
+    std::shared_ptr<FactT> out = output_facts[slot];
+    for (;; --it, --slot) {
+      if (&*it == &I && !input) {
+        return out;
+      }
+      std::shared_ptr<FactT> in = input_facts[slot];
+      if (!in) {
+        in = std::make_shared<FactT>();
+        visit(*it, in, out);
+      }
+      if (&*it == &I) {
+        return in;
+      }
+      out = in;
+    }
+  }
+}
+
+// Calls solve(F) for every function F of M in scope on up to jobs threads
+// and adds up the counters it returns
+template <class SolveT>
+DataflowStats solveFunctions(llvm::Module &M, unsigned jobs,
+                             const FunctionScope &scope, SolveT solve) {
+  std::vector<llvm::Function *> functions;
+  for (llvm::Function &F : M) {
+    if (scope.contains(F)) {
+      functions.push_back(&F);
+    }
+  }
+
+  std::vector<DataflowStats> function_stats(functions.size());
+  parallelFor(jobs, functions.size(),
+              [&](size_t i) { function_stats[i] = solve(*functions[i]); });
+
+  DataflowStats stats;
+  for (const DataflowStats &s : function_stats) {
+    stats += s;
+  }
+  return stats;
+}
+
+// Solves F to a fixpoint using the facts in input_facts and output_facts
+template <Direction Dir, class FactT, class TransferT>
+DataflowStats solveDataflow(llvm::Function &F, FactTable<FactT> &input_facts,
+                            FactTable<FactT> &output_facts,
+                            TransferT transfer,
+                            BlockOrder block_order = BlockOrder::Priority) {
+  DataflowEngine<Dir, FactT, TransferT> engine(input_facts, output_facts,
+                                               transfer, block_order);
+  return engine.run(F);
+}
+
+} // namespace errspec
+
+#endif
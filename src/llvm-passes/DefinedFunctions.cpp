@@ -14,15 +14,8 @@ bool DefinedFunctions::runOnFunction(Function &F) {
     // This is a function pass not a module pass.
     // we don't need to explicitly strip out intrinsics or declarations.
 
-    string fname = F.getName().str();
-    auto idx = fname.find('.');
-    if (idx != string::npos) {
-      fname = fname.substr(0, idx);
-    }
-    defined_functions.insert(fname);
-
-    F.getReturnType()->print(llvm::outs());
-    llvm::outs() << " " << fname << "\n";
+    defined_functions.insert(getDefinedName(F));
+    print(F, llvm::outs());
 
     // Works in LLVM 3.8
     // -------------------------
@@ -38,6 +31,20 @@ bool DefinedFunctions::runOnFunction(Function &F) {
     return false;
 }
 
+string DefinedFunctions::getDefinedName(const Function &F) {
+  string fname = F.getName().str();
+  auto idx = fname.find('.');
+  if (idx != string::npos) {
+    fname = fname.substr(0, idx);
+  }
+  return fname;
+}
+
+void DefinedFunctions::print(const Function &F, raw_ostream &out) {
+  F.getReturnType()->print(out);
+  out << " " << getDefinedName(F) << "\n";
+}
+
 std::unordered_set<std::string> DefinedFunctions::getDefinedFunctions() {
   return defined_functions;
 }
@@ -17,6 +17,13 @@ struct DefinedFunctions : public llvm::FunctionPass {
   bool runOnFunction(llvm::Function &F) override;
   std::unordered_set<std::string> getDefinedFunctions();
 
+  // The name of F without the numeric suffix LLVM adds to copies
+  static std::string getDefinedName(const llvm::Function &F);
+
+  // Prints the return type and name of F. Only needs the function's header,
+  // so it also works on bodies that were never read from the bitcode.
+  static void print(const llvm::Function &F, llvm::raw_ostream &out);
+
  private:
   std::unordered_set<std::string> defined_functions;
 };
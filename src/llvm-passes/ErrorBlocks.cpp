@@ -1,14 +1,16 @@
 #include "ErrorBlocks.h"
+#include "CallGraphSCCs.h"
+#include "CallSiteIndex.h"
 #include "Common.h"
+#include "Parallel.hpp"
 #include "ReturnConstraints.h"
 #include "ReturnPropagation.h"
 #include "ReturnedValues.h"
+#include "SpecFiles.h"
 #include "Utility.hpp"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Module.h"
 #include <glog/logging.h>
-#include <boost/algorithm/string.hpp>
-#include <fstream>
 #include <iostream>
 #include <unordered_map>
 
@@ -22,61 +24,280 @@ bool dbg = false;
 // Rule,f,B_location,callsite_location,v,E(f)_in,E(f)_out,CallCon(B,f),c,E(g)
 
 ErrorBlocks::ErrorBlocks(string error_only_path) : ModulePass(ID) {
-  readErrorOnlyFile(error_only_path);
+  unordered_set<string> error_only = readErrorOnlyFile(error_only_path);
+  if (error_only.empty()) {
+    LOG(WARNING) << "EMPTY ERROR-ONLY SET!";
+  }
+  configure(error_only, {});
 }
 
-ErrorBlocks::ErrorBlocks(string error_only_path, string input_specs_path)
-    : ModulePass(ID) {
-  readErrorOnlyFile(error_only_path);
-  readInputSpecsFile(input_specs_path);
+ErrorBlocks::ErrorBlocks(string error_only_path, string input_specs_path,
+                         unsigned jobs)
+    : ModulePass(ID), jobs(jobs) {
+  unordered_set<string> error_only = readErrorOnlyFile(error_only_path);
+  if (error_only.empty()) {
+    LOG(WARNING) << "EMPTY ERROR-ONLY SET!";
+  }
+  unordered_map<string, Constraint> input_specs =
+      readInputSpecsFile(input_specs_path);
+  if (input_specs.empty()) {
+    LOG(WARNING) << "EMPTY INPUT SPECS LIST!\n";
+  }
+  configure(error_only, input_specs);
 }
 
-void ErrorBlocks::readErrorOnlyFile(string error_only_path) {
-  string line;
+ErrorBlocks::ErrorBlocks(const unordered_set<string> &error_only,
+                         const unordered_map<string, Constraint> &input_specs,
+                         unsigned jobs)
+    : ModulePass(ID), jobs(jobs) {
+  configure(error_only, input_specs);
+}
 
-  // Read error-only functions from text file line by line
-  // and insert them into the set of error-only functions.
-  ifstream error_only_file(error_only_path);
-  while (getline(error_only_file, line)) {
-    error_only.insert(line);
+// Input specifications seed the AERV map
+void ErrorBlocks::configure(const unordered_set<string> &error_only,
+                            const unordered_map<string, Constraint> &input_specs) {
+  this->error_only = error_only;
+  this->input_specs = input_specs;
+  for (const auto &spec : input_specs) {
+    setAERV(spec.first, spec.second);
   }
-  if (error_only.size() == 0) {
-    LOG(WARNING) << "EMPTY ERROR-ONLY SET!";
+}
+
+// Functions are scheduled bottom-up over the SCCs of the call graph, so the
+// AERVs of callees are final before their callers are visited.
+bool ErrorBlocks::runOnModule(Module &M) {
+  LOG(INFO) << "Init";
+  return_constraints = &getAnalysis<ReturnConstraints>();
+  returned_values = &getAnalysis<ReturnedValues>();
+  return_propagation = &getAnalysis<ReturnPropagation>();
+  call_sites = &getAnalysis<CallSiteIndex>();
+  call_sites->markCallees(CallSiteIndex::ErrorOnly, error_only);
+  error_codes = ErrorCodeClassifier(error_code_table, &M);
+
+  if (summarize) {
+    vector<Function *> functions;
+    for (Function &F : M) {
+      if (!F.isDeclaration() && summary_scope.contains(F)) {
+        functions.push_back(&F);
+      }
+    }
+    summaries.resize(functions.size());
+    parallelFor(jobs, functions.size(), [&](size_t i) {
+      summarizeFunction(*functions[i], summaries[i]);
+    });
+  }
+
+  if (!infer) {
+    return false;
+  }
+  if (previous) {
+    loadWarmStart(M);
+  }
+  if (jobs > 1) {
+    runParallel(M);
+  } else {
+    runSerial(M);
+  }
+
+  if (previous && verify_warm_start) {
+    unordered_map<string, Constraint> warm_specs = getErrorReturnValues();
+    set<ErrorPropagationEdge> warm_propagation = error_propagation;
+    unordered_set<string> warm_bootstrap = error_only_bootstrap;
+
+    reset();
+    previous = nullptr;
+    if (jobs > 1) {
+      runParallel(M);
+    } else {
+      runSerial(M);
+    }
+
+    unordered_map<string, Constraint> cold_specs = getErrorReturnValues();
+    bool same_specs = warm_specs.size() == cold_specs.size();
+    for (const auto &spec : cold_specs) {
+      auto warm = warm_specs.find(spec.first);
+      if (warm == warm_specs.end() ||
+          warm->second.interval != spec.second.interval) {
+        LOG(ERROR) << "Warm start: spec of " << spec.first
+                   << " differs from a cold run";
+        same_specs = false;
+      }
+    }
+    warm_start_verified = same_specs &&
+                          warm_propagation == error_propagation &&
+                          warm_bootstrap == error_only_bootstrap;
+    LOG(INFO) << "Warm start verified: " << warm_start_verified;
+  }
+  return false;
+}
+
+void ErrorBlocks::warmStart(const WarmStart &previous,
+                            unordered_set<const Function *> dirty) {
+  this->previous = &previous;
+  this->dirty = std::move(dirty);
+}
+
+// The results of the clean functions are taken from the previous run. The
+// AERVs of declarations come from the input specifications alone.
+void ErrorBlocks::loadWarmStart(Module &M) {
+  unsigned clean = 0;
+  for (Function &F : M) {
+    if (F.isDeclaration() || dirty.count(&F)) {
+      continue;
+    }
+    ++clean;
+    string fname = F.getName();
+    auto spec = previous->specs.find(fname);
+    if (spec != previous->specs.end()) {
+      setAERV(fname, spec->second);
+    }
+    if (previous->error_only_bootstrap.count(fname)) {
+      error_only_bootstrap.insert(fname);
+    }
+  }
+  for (const ErrorPropagationEdge &edge : previous->error_propagation) {
+    Function *to = M.getFunction(edge.second);
+    if (to && !to->isDeclaration() && !dirty.count(to)) {
+      error_propagation.insert(edge);
+    }
   }
+  LOG(INFO) << "Warm start: " << clean << " clean functions, "
+            << dirty.size() << " dirty";
 }
 
-void ErrorBlocks::readInputSpecsFile(string input_specs_path) {
-  string line;
+// Back to the state after configure
+void ErrorBlocks::reset() {
+  abstract_error_return_values.clear();
+  error_return_values.clear();
+  error_propagation.clear();
+  error_only_bootstrap.clear();
+  for (const auto &spec : input_specs) {
+    setAERV(spec.first, spec.second);
+  }
+}
 
-  // Read input specifications from text file line by line
-  // and insert them into AERV map
-  ifstream input_specs_file(input_specs_path);
-  bool have_input_specs = false;
-  while (getline(input_specs_file, line)) {
-    have_input_specs = true;
-    // need to split fname from spec
-    vector<string> fields;
-    boost::split(fields, line, boost::is_any_of(" "));
-    string fname = fields[0];
-    Constraint c(fname, fields[1]);
-    setAERV(fname, c);
+// The functions of an SCC are all clean or all dirty, since they call each
+// other
+bool ErrorBlocks::isClean(const vector<Function *> &scc) const {
+  return previous && !dirty.count(scc.front());
+}
+
+// When the AERV of a function changes only its callers are revisited: callers
+// in the same SCC immediately, the others when their SCC comes up.
+void ErrorBlocks::runSerial(Module &M) {
+  CallGraphSCCs call_graph(M);
+  const auto &sccs = call_graph.getSCCs();
+
+  // Callers of a dirty function are dirty, so clean SCCs never enter the
+  // worklist
+  set<unsigned> worklist;
+  for (unsigned i = 0, e = sccs.size(); i != e; ++i) {
+    if (!isClean(sccs[i])) {
+      worklist.insert(i);
+    }
   }
 
-  if (!have_input_specs) {
-    LOG(WARNING) << "EMPTY INPUT SPECS LIST!\n";
+  function_visits = 0;
+  while (!worklist.empty()) {
+    unsigned scc_idx = *worklist.begin();
+    worklist.erase(worklist.begin());
+
+    bool scc_changed = true;
+    while (scc_changed) {
+      scc_changed = false;
+      for (Function *F : sccs[scc_idx]) {
+        if (!scope.contains(*F)) {
+          continue;
+        }
+        ++function_visits;
+        if (!runOnFunctionAERVChanged(*F)) {
+          continue;
+        }
+        for (Function *caller : call_graph.getCallers(F->getName())) {
+          unsigned caller_idx = call_graph.getSCCIndex(caller);
+          if (caller_idx == scc_idx) {
+            scc_changed = true;
+          } else {
+            worklist.insert(caller_idx);
+          }
+        }
+      }
+    }
   }
+
+  LOG(INFO) << "ErrorBlocks: " << function_visits << " function visits for "
+            << sccs.size() << " call graph SCCs";
 }
 
-bool ErrorBlocks::runOnModule(Module &M) {
-  LOG(INFO) << "Init";
-  bool changed = true;
-  while (changed) {
-    changed = false;
-    for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-      changed = runOnFunction(*fi) || changed;
+// An SCC is handed to a worker thread once every SCC it calls into has
+// reached its fixpoint, and is then iterated to its own fixpoint by that
+// thread alone. Every function therefore sees exactly the callee AERVs it
+// would see in the serial schedule, and the resulting specifications are
+// the same.
+void ErrorBlocks::runParallel(Module &M) {
+  CallGraphSCCs call_graph(M);
+  const auto &sccs = call_graph.getSCCs();
+
+  // Edges of the SCC DAG, from callee SCC to caller SCC
+  vector<vector<unsigned>> dependents(sccs.size());
+  vector<unsigned> num_deps(sccs.size(), 0);
+  for (unsigned i = 0, e = sccs.size(); i != e; ++i) {
+    set<unsigned> callee_sccs;
+    for (Function *F : sccs[i]) {
+      for (Function *callee : call_graph.getCallees(F)) {
+        unsigned callee_idx = call_graph.getSCCIndex(callee);
+        if (callee_idx != i) {
+          callee_sccs.insert(callee_idx);
+        }
+      }
+    }
+    for (unsigned callee_idx : callee_sccs) {
+      dependents[callee_idx].push_back(i);
     }
+    num_deps[i] = callee_sccs.size();
   }
-  return false;
+
+  function_visits = 0;
+  parallelDAG(jobs, dependents, num_deps, [&](unsigned scc_idx) {
+    bool scc_changed = !isClean(sccs[scc_idx]);
+    while (scc_changed) {
+      scc_changed = false;
+      for (Function *F : sccs[scc_idx]) {
+        if (!scope.contains(*F)) {
+          continue;
+        }
+        ++function_visits;
+        if (!runOnFunctionAERVChanged(*F)) {
+          continue;
+        }
+        for (Function *caller : call_graph.getCallers(F->getName())) {
+          if (call_graph.getSCCIndex(caller) == scc_idx) {
+            scc_changed = true;
+          }
+        }
+      }
+    }
+  });
+
+  LOG(INFO) << "ErrorBlocks: " << function_visits << " function visits for "
+            << sccs.size() << " call graph SCCs on " << jobs << " threads";
+}
+
+// Returns true if the AERV of F changed
+bool ErrorBlocks::runOnFunctionAERVChanged(Function &F) {
+  string fname = F.getName();
+  bool had_aerv = haveAERV(fname);
+  Constraint old_aerv;
+  if (had_aerv) {
+    old_aerv = getAERV(fname);
+  }
+
+  runOnFunction(F);
+
+  if (!haveAERV(fname)) {
+    return false;
+  }
+  return !had_aerv || getAERV(fname) != old_aerv;
 }
 
 bool ErrorBlocks::runOnFunction(Function &F) {
@@ -100,16 +321,12 @@ bool ErrorBlocks::visitBlock(BasicBlock &BB) {
       changed = visitCallInst(*inst) || changed;
     }
   }
-  ReturnConstraints &return_constraints = getAnalysis<ReturnConstraints>();
-  ReturnedValues &returned_values = getAnalysis<ReturnedValues>();
-  ReturnPropagation &return_propagation = getAnalysis<ReturnPropagation>();
-
   string parent_fname = BB.getParent()->getName();
   Instruction *bb_first = GetFirstInstructionOfBB(&BB);
   Instruction *bb_last = GetLastInstructionOfBB(&BB);
 
-  ReturnConstraintsFact rcf = return_constraints.getOutFact(bb_last);
-  ReturnedValuesFact rtf = returned_values.getInFact(bb_first);
+  ReturnConstraintsFact rcf = return_constraints->getOutFact(bb_last);
+  ReturnedValuesFact rtf = returned_values->getInFact(bb_first);
   if (rtf.value.size() > 1)
     return false;
 
@@ -123,7 +340,7 @@ bool ErrorBlocks::visitBlock(BasicBlock &BB) {
       }
       int64_t return_value = int_return->getSExtValue();
 
-      if (error_codes.find(return_value) != error_codes.end()) {
+      if (error_codes.contains(return_value)) {
         changed = addErrorValue(BB.getParent(), return_value) || changed;
 
         string file;
@@ -145,9 +362,11 @@ bool ErrorBlocks::visitBlock(BasicBlock &BB) {
   // block execution
   // Constraint constraint_aerv is the abstract error return value of
   // constraint_f
-  for (auto kv : rcf.value) {
-    string constraint_fname = kv.first;
-    Constraint block_constraint = kv.second;
+  const FunctionIds &function_ids = return_constraints->getFunctionIds();
+  for (auto &entry : rcf.value) {
+    string constraint_fname = function_ids.getName(entry.first);
+    Constraint block_constraint(constraint_fname);
+    block_constraint.interval = entry.second;
 
     // Function constraining this block does not have an AERV (yet)
     // so block constraint can't make it an error block
@@ -222,74 +441,38 @@ bool ErrorBlocks::visitBlock(BasicBlock &BB) {
           }
         }
 
-        if (isa<CallInst>(returned_value)) {
-          // DIRECT PROPAGATION
-          // We are returning a call instruction
-          // If it is a call instruction,
-          // check to see if we have aerv of that function
-          CallInst *call = dyn_cast<CallInst>(returned_value);
-          string callee_name = getCalleeName(*call);
-          if (haveAERV(callee_name)) {
-            Constraint callee_aerv = getAERV(callee_name);
-            propagate_callee = callee_name;
-
-            string file;
-            unsigned line;
-            if (DILocation *loc = bb_last->getDebugLoc()) {
-              file = loc->getFilename();
-              line = loc->getLine();
-            }
-            LOG(INFO) << "Propagation"
-                      << " f=" << parent_fname
-                      << " S=" << file << ":" << line
-                      << " fprime=" << constraint_fname
-                      << " constraint=\"" << block_constraint.interval << "\""
-                      << " E(fprime)=\"" << constraint_aerv.interval << "\""
-                      << " g=\"" << propagate_callee << "\""
-                      << " E(g)=\"" << callee_aerv.interval << "\"";
-
-            return_interval = callee_aerv.interval;
-          }
-        } else {
-          // INDIRECT PROPAGATION
-          // We are returning a value which can hold a call instruction at this
-          // program point
-          // Check to see if returned value can hold return value of function
-          ReturnPropagationFact rpf =
-              *(return_propagation.output_facts.at(bb_last));
-
-          if (rpf.value.find(returned_value) != rpf.value.end()) {
-            if (rpf.value.at(returned_value).size() > 1) {
-              continue;
-            }
-
-            for (const auto &v : rpf.value.at(returned_value)) {
-              if (CallInst *call = dyn_cast<CallInst>(v)) {
-                string callee_name = getCalleeName(*call);
-                if (haveAERV(callee_name)) {
-                  Constraint callee_aerv = getAERV(callee_name);
-                  propagate_callee = callee_name;
-
-                  string file;
-                  unsigned line;
-                  if (DILocation *loc = bb_last->getDebugLoc()) {
-                    file = loc->getFilename();
-                    line = loc->getLine();
-                  }
-                  LOG(INFO) << "Propagation"
-                            << " f=" << parent_fname
-                            << " S=" << file << ":" << line
-                            << " fprime=" << constraint_fname
-                            << " constraint=\"" << block_constraint.interval << "\""
-                            << " E(fprime)=\"" << constraint_aerv.interval << "\""
-                            << " g=\"" << propagate_callee << "\""
-                            << " E(g)=\"" << callee_aerv.interval << "\"";
-
-                  return_interval = callee_aerv.interval;
-                }
-              }
-            }
+        // DIRECT PROPAGATION: we are returning a call instruction.
+        // INDIRECT PROPAGATION: we are returning a value which can hold the
+        // return value of a call at this program point.
+        // Either way, check to see if we have aerv of that function
+        CallInst *call = nullptr;
+        if (!getReturnedCall(returned_value, bb_last, call)) {
+          continue;
+        }
+        string callee_name =
+            call ? call_sites->getFunctionIds().getName(
+                       call_sites->getCallInfo(*call).id)
+                 : "";
+        if (call && haveAERV(callee_name)) {
+          Constraint callee_aerv = getAERV(callee_name);
+          propagate_callee = callee_name;
+
+          string file;
+          unsigned line;
+          if (DILocation *loc = bb_last->getDebugLoc()) {
+            file = loc->getFilename();
+            line = loc->getLine();
           }
+          LOG(INFO) << "Propagation"
+                    << " f=" << parent_fname
+                    << " S=" << file << ":" << line
+                    << " fprime=" << constraint_fname
+                    << " constraint=\"" << block_constraint.interval << "\""
+                    << " E(fprime)=\"" << constraint_aerv.interval << "\""
+                    << " g=\"" << propagate_callee << "\""
+                    << " E(g)=\"" << callee_aerv.interval << "\"";
+
+          return_interval = callee_aerv.interval;
         }
         return_constraint.interval = return_interval;
 
@@ -317,50 +500,152 @@ bool ErrorBlocks::visitBlock(BasicBlock &BB) {
   return changed;
 }
 
+// Sets call to the call whose result returned_value is at the end of the
+// block, or to null if it is not the result of a call. Returns false if it
+// may be the result of several calls.
+bool ErrorBlocks::getReturnedCall(Value *returned_value, Instruction *bb_last,
+                                  CallInst *&call) const {
+  call = dyn_cast<CallInst>(returned_value);
+  if (call) {
+    return true;
+  }
+
+  shared_ptr<ReturnPropagationFact> rpf =
+      return_propagation->getOutFact(bb_last);
+  auto held = rpf->value.find(returned_value);
+  if (held == rpf->value.end()) {
+    return true;
+  }
+  if (held->second.size() > 1) {
+    return false;
+  }
+  for (Value *v : held->second) {
+    call = dyn_cast<CallInst>(v);
+  }
+  return true;
+}
+
+// Records what visitBlock and visitCallInst find in F without reading any
+// AERV, so the summary holds whatever the specifications of other
+// functions turn out to be
+void ErrorBlocks::summarizeFunction(Function &F,
+                                    FunctionSummary &summary) const {
+  summary.name = F.getName();
+  const FunctionIds &function_ids = return_constraints->getFunctionIds();
+
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      CallInst *call = dyn_cast<CallInst>(&I);
+      if (!call || !call_sites->hasFlag(*call, CallSiteIndex::ErrorOnly)) {
+        continue;
+      }
+      summary.error_only_call = true;
+      ReturnedValuesFact rtf = returned_values->getInFact(call);
+      for (Value *v : rtf.value) {
+        if (ConstantInt *int_return = dyn_cast<ConstantInt>(v)) {
+          summary.error_values.insert(int_return->getSExtValue());
+        } else if (isa<ConstantPointerNull>(v)) {
+          summary.error_values.insert(0);
+        }
+      }
+    }
+
+    Instruction *bb_first = GetFirstInstructionOfBB(&BB);
+    Instruction *bb_last = GetLastInstructionOfBB(&BB);
+    ReturnedValuesFact rtf = returned_values->getInFact(bb_first);
+    if (rtf.value.size() > 1) {
+      continue;
+    }
+
+    ReturnConstraintsFact rcf = return_constraints->getOutFact(bb_last);
+    for (Value *returned_value : rtf.value) {
+      // Error codes and constants returned when a callee fails
+      Interval constant = Interval::BOT;
+      if (ConstantInt *int_return = dyn_cast<ConstantInt>(returned_value)) {
+        if (int_return->getBitWidth() <= 64) {
+          int64_t return_value = int_return->getSExtValue();
+          if (error_codes.contains(return_value)) {
+            summary.error_values.insert(return_value);
+          }
+          constant = abstractInteger(return_value);
+        }
+      } else if (isa<ConstantPointerNull>(returned_value)) {
+        constant = abstractInteger(0);
+      }
+
+      CallInst *call = nullptr;
+      if (!getReturnedCall(returned_value, bb_last, call)) {
+        continue;
+      }
+
+      for (auto &entry : rcf.value) {
+        GuardedReturn r;
+        r.guard = function_ids.getName(entry.first);
+        r.guard_interval = entry.second;
+        if (r.guard_interval != Interval::TOP) {
+          r.value = constant;
+        }
+        if (call) {
+          r.callee = function_ids.getName(call_sites->getCallInfo(*call).id);
+        }
+        summary.returns.insert(r);
+      }
+    }
+  }
+}
+
+vector<FunctionSummary> ErrorBlocks::getSummaries() const {
+  return summaries;
+}
+
+bool ErrorBlocks::readsReturnedValuesAt(const Instruction &I) {
+  return isa<CallInst>(I);
+}
+
 bool ErrorBlocks::visitCallInst(CallInst &I) {
   // If block contains a call to an error only function
   // Get the set of values that it can return
   // Add those values to error_values
-  string callee_name = getCalleeName(I);
-
-  ReturnedValues &returned_values = getAnalysis<ReturnedValues>();
+  FunctionId callee = call_sites->getCallInfo(I).id;
+  if (!call_sites->hasFlag(callee, CallSiteIndex::ErrorOnly)) {
+    return false;
+  }
+  const string &callee_name = call_sites->getFunctionIds().getName(callee);
 
   Function *parent = I.getParent()->getParent();
 
   bool changed = false;
 
-  // Call to error-only function
-  if (error_only.find(callee_name) != error_only.end()) {
-    // Get set of values that can be returned from this instruction
-    ReturnedValuesFact rtf = returned_values.getInFact(&I);
+  // Get set of values that can be returned from this instruction
+  ReturnedValuesFact rtf = returned_values->getInFact(&I);
 
-    string file;
-    unsigned line;
-    if (DILocation *loc = I.getDebugLoc()) {
-      file = loc->getFilename();
-      line = loc->getLine();
-    }
+  string file;
+  unsigned line;
+  if (DILocation *loc = I.getDebugLoc()) {
+    file = loc->getFilename();
+    line = loc->getLine();
+  }
 
-    for (const auto &v : rtf.value) {
-      if (ConstantInt *int_return = dyn_cast<ConstantInt>(v)) {
-        int64_t return_value = int_return->getSExtValue();
-        changed = addErrorValue(parent, return_value) || changed;
-        LOG(INFO) << "ErrorOnlyCall"
-                  << " eo=" << callee_name
-                  << " callsite=" << file  << ":" << line
-                  << " c=" << return_value;
-      } else if (isa<ConstantPointerNull>(v)) {
-        changed = addErrorValue(parent, 0) || changed;
-        LOG(INFO) << "ErrorOnlyCall"
-                  << " eo=" << callee_name
-                  << " callsite=" << file  << ":" << line
-                  << " c=0";
-      }
+  for (const auto &v : rtf.value) {
+    if (ConstantInt *int_return = dyn_cast<ConstantInt>(v)) {
+      int64_t return_value = int_return->getSExtValue();
+      changed = addErrorValue(parent, return_value) || changed;
+      LOG(INFO) << "ErrorOnlyCall"
+                << " eo=" << callee_name
+                << " callsite=" << file  << ":" << line
+                << " c=" << return_value;
+    } else if (isa<ConstantPointerNull>(v)) {
+      changed = addErrorValue(parent, 0) || changed;
+      LOG(INFO) << "ErrorOnlyCall"
+                << " eo=" << callee_name
+                << " callsite=" << file  << ":" << line
+                << " c=0";
     }
-
-    error_only_bootstrap.insert(parent->getName());
   }
 
+  lock_guard<mutex> lock(state_mutex);
+  error_only_bootstrap.insert(parent->getName());
+
   return changed;
 }
 
@@ -368,14 +653,17 @@ bool ErrorBlocks::addErrorValue(Function *f, int64_t v) {
   bool changed = false;
 
   // Insert constant into error_return_values
-  if (error_return_values.find(f) == error_return_values.end()) {
-    error_return_values[f] = unordered_set<int64_t>({v});
-    changed = true;
-  } else {
-    if (error_return_values[f].find(v) == error_return_values[f].end()) {
+  {
+    lock_guard<mutex> lock(state_mutex);
+    if (error_return_values.find(f) == error_return_values.end()) {
+      error_return_values[f] = unordered_set<int64_t>({v});
       changed = true;
+    } else {
+      if (error_return_values[f].find(v) == error_return_values[f].end()) {
+        changed = true;
+      }
+      error_return_values[f].insert(v);
     }
-    error_return_values[f].insert(v);
   }
 
   // Insert abstraction of constant in abstract_error_return_values
@@ -383,7 +671,7 @@ bool ErrorBlocks::addErrorValue(Function *f, int64_t v) {
   c.interval = abstractInteger(v);
   string fname = f->getName();
   if (!haveAERV(fname)) {
-    abstract_error_return_values[fname] = c;
+    abstract_error_return_values.set(fname, c);
     changed = true;
   } else {
     Constraint old_aerv = getAERV(fname);
@@ -400,14 +688,15 @@ bool ErrorBlocks::addErrorValue(Function *f, int64_t v) {
 
 void ErrorBlocks::addErrorPropagation(string from, string to) {
   auto edge = std::make_pair(from, to);
+  lock_guard<mutex> lock(state_mutex);
   error_propagation.insert(edge);
 }
 
 unordered_map<string, Constraint> ErrorBlocks::getErrorReturnValues() const {
-  return abstract_error_return_values;
+  return abstract_error_return_values.snapshot();
 }
 
-Interval ErrorBlocks::abstractInteger(int64_t v) const {
+Interval ErrorBlocks::abstractInteger(int64_t v) {
   if (v < 0) {
     return Interval::LTZ;
   } else if (v > 0) {
@@ -418,26 +707,25 @@ Interval ErrorBlocks::abstractInteger(int64_t v) const {
 }
 
 bool ErrorBlocks::haveAERV(string fname) const {
-  return abstract_error_return_values.find(fname) !=
-         abstract_error_return_values.end();
+  return abstract_error_return_values.contains(fname);
 }
 
 // A constraint object just to use the join function - needs refactor
 Constraint ErrorBlocks::getAERV(string fname) const {
-  if (abstract_error_return_values.find(fname) ==
-      abstract_error_return_values.end()) {
+  Constraint c;
+  if (!abstract_error_return_values.get(fname, c)) {
     cerr << "ERROR: no AERV for function " << fname << endl;
     exit(1);
   }
 
-  return abstract_error_return_values.at(fname);
+  return c;
 }
 
 bool ErrorBlocks::setAERV(string fname, Constraint c) {
   if (dbg) {
     cerr << "setAERV of " << fname << " to " << c << endl;
   }
-  abstract_error_return_values[fname] = c;
+  abstract_error_return_values.set(fname, c);
   return true;
 }
 
@@ -445,6 +733,7 @@ void ErrorBlocks::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addRequired<ReturnPropagation>();
   AU.addRequired<ReturnedValues>();
   AU.addRequired<ReturnConstraints>();
+  AU.addRequired<CallSiteIndex>();
   AU.setPreservesAll();
 }
 
@@ -11,6 +11,8 @@
 #ifndef ERRORBLOCKS_H
 #define ERRORBLOCKS_H
 
+#include <atomic>
+#include <mutex>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -18,6 +20,11 @@
 #include <vector>
 
 #include "Constraint.h"
+#include "Dataflow.hpp"
+#include "ErrorCodes.h"
+#include "ErrorSummary.h"
+#include "ShardedMap.hpp"
+#include "WarmStart.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InstIterator.h"
@@ -26,11 +33,21 @@
 
 typedef std::pair<std::string, std::string> ErrorPropagationEdge;
 
+class CallSiteIndex;
+class ReturnConstraints;
+class ReturnedValues;
+struct ReturnPropagation;
+
 struct ErrorBlocks : public llvm::ModulePass {
   static char ID;
   ErrorBlocks() : ModulePass(ID) {}
   ErrorBlocks(std::string error_only_path);
-  ErrorBlocks(std::string error_only_path, std::string input_specs_path);
+  ErrorBlocks(std::string error_only_path, std::string input_specs_path,
+              unsigned jobs = 1);
+  // With the contents of the files, already read
+  ErrorBlocks(const std::unordered_set<std::string> &error_only,
+              const std::unordered_map<std::string, Constraint> &input_specs,
+              unsigned jobs = 1);
 
   // Entry point
   bool runOnModule(llvm::Module &M);
@@ -39,10 +56,46 @@ struct ErrorBlocks : public llvm::ModulePass {
 
   std::unordered_map<std::string, Constraint> getErrorReturnValues() const;
 
+  // The interior points at which this pass reads ReturnedValues facts. It
+  // reads the other analyses only at block entries and exits.
+  static bool readsReturnedValuesAt(const llvm::Instruction &I);
+
   bool haveAERV(std::string fname) const;
   Constraint getAERV(std::string fname) const;
   bool setAERV(std::string fname, Constraint c);
 
+  // Build a summary of every defined function in summary_scope (see
+  // ErrorSummary.h)
+  bool summarize = false;
+  errspec::FunctionScope summary_scope;
+
+  // Infer the specifications of this module. Off when only the summaries
+  // are needed.
+  bool infer = true;
+
+  // Functions that are solved. The others get no specification, so they
+  // must not be able to get one (see Relevance.h).
+  errspec::FunctionScope scope;
+
+  // Constants that are error codes when returned (see ErrorCodes.h)
+  errspec::ErrorCodeTable error_code_table = errspec::defaultErrorCodes();
+
+  std::vector<errspec::FunctionSummary> getSummaries() const;
+
+  // Start from the results of a previous run and solve only the dirty
+  // functions again (see WarmStart.h)
+  void warmStart(const errspec::WarmStart &previous,
+                 std::unordered_set<const llvm::Function *> dirty);
+
+  // After a warm start, also solve every function from scratch and compare.
+  // The results of the cold run are kept.
+  bool verify_warm_start = false;
+  // False if the verification found a difference
+  bool warm_start_verified = true;
+
+  // The interval of an error constant
+  static Interval abstractInteger(int64_t);
+
   // Set of error propagation edges
   std::set<ErrorPropagationEdge> error_propagation;
 
@@ -50,10 +103,18 @@ struct ErrorBlocks : public llvm::ModulePass {
   std::unordered_set<std::string> error_only_bootstrap;
 
 private:
-  void readErrorOnlyFile(std::string error_only_path);
-  void readInputSpecsFile(std::string input_specs_path);
+  void configure(const std::unordered_set<std::string> &error_only,
+                 const std::unordered_map<std::string, Constraint> &input_specs);
+
+  void runSerial(llvm::Module &M);
+  void runParallel(llvm::Module &M);
+
+  void loadWarmStart(llvm::Module &M);
+  void reset();
+  bool isClean(const std::vector<llvm::Function *> &scc) const;
 
   bool runOnFunction(llvm::Function &F);
+  bool runOnFunctionAERVChanged(llvm::Function &F);
 
   // Called for each basic block
   bool visitBlock(llvm::BasicBlock &BB);
@@ -64,13 +125,36 @@ private:
 
   void addErrorPropagation(std::string from, std::string to);
 
-  Interval abstractInteger(int64_t) const;
+  bool getReturnedCall(llvm::Value *returned_value,
+                       llvm::Instruction *bb_last,
+                       llvm::CallInst *&call) const;
+  void summarizeFunction(llvm::Function &F,
+                         errspec::FunctionSummary &summary) const;
+
+  // Summaries in module order, empty ones included
+  std::vector<errspec::FunctionSummary> summaries;
+
+  // Number of threads analyzing call graph SCCs
+  unsigned jobs = 1;
+  std::atomic<uint64_t> function_visits{0};
+
+  // Fetched once in runOnModule so that worker threads never go through
+  // the pass manager
+  ReturnConstraints *return_constraints = nullptr;
+  ReturnedValues *returned_values = nullptr;
+  ReturnPropagation *return_propagation = nullptr;
+
+  // Resolves calls to their callee ids, with error-only callees marked
+  CallSiteIndex *call_sites = nullptr;
 
   // A block is an error block if it calls an error-only function
   // or if the constraint on that block satisfies the error
   // specification of a function
   std::unordered_map<llvm::BasicBlock *, bool> error_states;
 
+  // Guards error_return_values, error_propagation and error_only_bootstrap
+  std::mutex state_mutex;
+
   // A map from functions to the integer-like constants that
   // may be returned on error
   // Note: the keys for this map will not be identical to the
@@ -83,20 +167,24 @@ private:
   // ** These are the the function error specifications **
   // A map from function names to the integer-like constants that
   // may be returned on error
-  std::unordered_map<std::string, Constraint> abstract_error_return_values;
+  // Functions in different SCCs are analyzed concurrently, each writing its
+  // own entry while reading the entries of its callees.
+  errspec::ShardedMap<std::string, Constraint> abstract_error_return_values;
 
   std::unordered_map<std::string, Constraint> abstract_success_return_values;
 
   // Error-only functions (from config file)
   std::unordered_set<std::string> error_only;
 
+  std::unordered_map<std::string, Constraint> input_specs;
+
+  // Previous run and the functions that must be solved again, if warm
+  // started
+  const errspec::WarmStart *previous = nullptr;
+  std::unordered_set<const llvm::Function *> dirty;
 
-  std::unordered_set<int64_t> error_codes = {
-    -114, -214, -314, -414, -514, -614, -714, -814, -914, -1014,
-    -1114, -1214, -1314, -1414, -1514, -1614, -1714, -1814, -1914,
-    -2014, -2114, -2214, -2314, -2414, -2514, -2614, -2714, -2814,
-    -2914, -3014, -3114, -3214, -3314, -3414, 114
-  };
+  // error_code_table compiled for the module
+  errspec::ErrorCodeClassifier error_codes;
 };
 
 #endif
@@ -0,0 +1,150 @@
+#include "ErrorCodes.h"
+#include "llvm/BinaryFormat/Dwarf.h"
+#include "llvm/IR/DebugInfo.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+
+using namespace llvm;
+using namespace std;
+
+namespace errspec {
+
+ErrorCodeTable defaultErrorCodes() {
+  ErrorCodeTable table;
+  for (int64_t code = -114; code >= -3414; code -= 100) {
+    table.ranges.push_back({code, code});
+  }
+  table.ranges.push_back({114, 114});
+  return table;
+}
+
+static bool parseCode(const string &field, int64_t &value) {
+  if (field.empty()) {
+    return false;
+  }
+  char *end;
+  errno = 0;
+  value = strtoll(field.c_str(), &end, 0);
+  return *end == '\0' && errno == 0;
+}
+
+bool readErrorCodesFile(const string &path, ErrorCodeTable &table) {
+  ifstream codes_file(path);
+  if (!codes_file) {
+    return false;
+  }
+
+  string line;
+  while (getline(codes_file, line)) {
+    istringstream fields(line);
+    string kind, first, second;
+    if (!(fields >> kind) || kind[0] == '#') {
+      continue;
+    }
+    fields >> first >> second;
+
+    int64_t low, high;
+    if (kind == "code" && parseCode(first, low)) {
+      table.ranges.push_back({low, low});
+    } else if (kind == "range" && parseCode(first, low) &&
+               parseCode(second, high) && low <= high) {
+      table.ranges.push_back({low, high});
+    } else if (kind == "enum" && !first.empty()) {
+      table.enums.push_back(first);
+    } else {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+vector<string> formatErrorCodes(const ErrorCodeTable &table) {
+  vector<string> lines;
+  for (const auto &range : table.ranges) {
+    if (range.first == range.second) {
+      lines.push_back("code " + to_string(range.first));
+    } else {
+      lines.push_back("range " + to_string(range.first) + " " +
+                      to_string(range.second));
+    }
+  }
+  for (const string &name : table.enums) {
+    lines.push_back("enum " + name);
+  }
+  return lines;
+}
+
+vector<string> ErrorCodeClassifier::format() const {
+  ErrorCodeTable resolved;
+  resolved.ranges = ranges;
+  return formatErrorCodes(resolved);
+}
+
+ErrorCodeClassifier::ErrorCodeClassifier(const ErrorCodeTable &table,
+                                         const Module *M) {
+  vector<pair<int64_t, int64_t>> codes = table.ranges;
+
+  if (M && !table.enums.empty()) {
+    unordered_set<string> enums(table.enums.begin(), table.enums.end());
+    DebugInfoFinder finder;
+    finder.processModule(*M);
+    for (DIType *type : finder.types()) {
+      DICompositeType *composite = dyn_cast<DICompositeType>(type);
+      if (!composite ||
+          composite->getTag() != dwarf::DW_TAG_enumeration_type ||
+          !enums.count(composite->getName().str())) {
+        continue;
+      }
+      for (DINode *element : composite->getElements()) {
+        if (DIEnumerator *enumerator = dyn_cast<DIEnumerator>(element)) {
+          int64_t value = enumerator->getValue();
+          codes.push_back({value, value});
+        }
+      }
+    }
+  }
+  if (codes.empty()) {
+    return;
+  }
+
+  // Overlapping and adjacent ranges are merged
+  std::sort(codes.begin(), codes.end());
+  for (const auto &range : codes) {
+    if (!ranges.empty() && (range.first <= ranges.back().second ||
+                            range.first - 1 == ranges.back().second)) {
+      ranges.back().second = max(ranges.back().second, range.second);
+    } else {
+      ranges.push_back(range);
+    }
+  }
+  low = ranges.front().first;
+  high = ranges.back().second;
+
+  uint64_t span = static_cast<uint64_t>(high) - static_cast<uint64_t>(low);
+  if (span < ERROR_CODES_MAX_BITMAP) {
+    bitmap.assign(span / 64 + 1, 0);
+    for (const auto &range : ranges) {
+      uint64_t first = static_cast<uint64_t>(range.first) - low;
+      uint64_t last = static_cast<uint64_t>(range.second) - low;
+      for (uint64_t bit = first; bit <= last; ++bit) {
+        bitmap[bit / 64] |= uint64_t(1) << (bit % 64);
+      }
+    }
+  }
+}
+
+// The last range that starts at or below value
+bool ErrorCodeClassifier::inRanges(int64_t value) const {
+  auto it = upper_bound(ranges.begin(), ranges.end(), value,
+                        [](int64_t v, const pair<int64_t, int64_t> &range) {
+                          return v < range.first;
+                        });
+  return it != ranges.begin() && value <= prev(it)->second;
+}
+
+} // namespace errspec
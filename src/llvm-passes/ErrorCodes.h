@@ -0,0 +1,86 @@
+// The integer constants that ErrorBlocks takes for error codes when a
+// function returns them.
+//
+// Error codes file: one entry per line
+// - code VALUE: a single code
+// - range LOW HIGH: every code from LOW to HIGH inclusive, like -4095 -1 for
+//   the Linux errnos
+// - enum NAME: the enumerators of the enum NAME in the debug info of the
+//   module
+// Values are decimal or hexadecimal (0x), with an optional sign. Empty lines
+// and lines starting with '#' are skipped.
+//
+// A table is compiled per module into an ErrorCodeClassifier, which holds
+// sorted, disjoint ranges. If the codes span at most ERROR_CODES_MAX_BITMAP
+// values it also holds one bit per value, so classifying a constant is a
+// bounds check and a bit test.
+
+#ifndef ERRORCODES_H
+#define ERRORCODES_H
+
+#include "llvm/IR/Module.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define ERROR_CODES_MAX_BITMAP (1 << 16)
+
+namespace errspec {
+
+struct ErrorCodeTable {
+  // A code is a range of one
+  std::vector<std::pair<int64_t, int64_t>> ranges;
+  std::vector<std::string> enums;
+};
+
+// The codes used when no error codes file is given
+ErrorCodeTable defaultErrorCodes();
+
+// Returns false if a line cannot be parsed
+bool readErrorCodesFile(const std::string &path, ErrorCodeTable &table);
+
+// One line per entry, in order
+std::vector<std::string> formatErrorCodes(const ErrorCodeTable &table);
+
+class ErrorCodeClassifier {
+public:
+  // Classifies nothing as an error code
+  ErrorCodeClassifier() {}
+
+  // The enums of table are looked up in M, if it is given
+  explicit ErrorCodeClassifier(const ErrorCodeTable &table,
+                               const llvm::Module *M = nullptr);
+
+  bool contains(int64_t value) const {
+    if (value < low || value > high) {
+      return false;
+    }
+    if (!bitmap.empty()) {
+      uint64_t bit = static_cast<uint64_t>(value) - static_cast<uint64_t>(low);
+      return (bitmap[bit / 64] >> (bit % 64)) & 1;
+    }
+    return inRanges(value);
+  }
+
+  // The codes after the enums are resolved, one "code" or "range" line per
+  // range in order, for hashing
+  std::vector<std::string> format() const;
+
+private:
+  // Empty until ranges are added
+  int64_t low = 1;
+  int64_t high = 0;
+
+  // Sorted by low end, disjoint and not adjacent
+  std::vector<std::pair<int64_t, int64_t>> ranges;
+
+  // Bit i is set if low + i is a code
+  std::vector<uint64_t> bitmap;
+
+  bool inRanges(int64_t value) const;
+};
+
+} // namespace errspec
+
+#endif
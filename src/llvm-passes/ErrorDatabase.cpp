@@ -0,0 +1,165 @@
+#include "ErrorDatabase.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sqlite3.h>
+#include <sstream>
+
+using namespace std;
+
+namespace errspec {
+
+static const char *schema =
+    "CREATE TABLE specs (function TEXT PRIMARY KEY, spec TEXT NOT NULL);"
+    "CREATE TABLE propagation (source TEXT NOT NULL, target TEXT NOT NULL);"
+    "CREATE TABLE error_only_bootstrap (function TEXT PRIMARY KEY);"
+    "CREATE TABLE call_counts (function TEXT PRIMARY KEY,"
+    "  checked INTEGER NOT NULL, unchecked INTEGER NOT NULL);"
+    "CREATE TABLE unchecked_calls (location TEXT NOT NULL,"
+    "  function TEXT NOT NULL);"
+    "CREATE TABLE error_only_reports (location TEXT NOT NULL,"
+    "  function TEXT NOT NULL, spec TEXT NOT NULL,"
+    "  error_only TEXT NOT NULL, error_only_spec TEXT NOT NULL);"
+    "CREATE VIEW bugs AS SELECT location, function, unchecked, checked"
+    "  FROM unchecked_calls JOIN call_counts USING (function);";
+
+// Built after the rows are inserted, which is faster than updating them
+// row by row
+static const char *indexes =
+    "CREATE INDEX specs_spec ON specs (spec);"
+    "CREATE INDEX propagation_source ON propagation (source);"
+    "CREATE INDEX propagation_target ON propagation (target);"
+    "CREATE INDEX unchecked_calls_function ON unchecked_calls (function);"
+    "CREATE INDEX error_only_reports_function ON error_only_reports"
+    "  (function);";
+
+namespace {
+
+// One prepared insert, reused for every row of its table
+class Insert {
+public:
+  Insert(sqlite3 *db, const char *sql) {
+    sqlite3_prepare_v2(db, sql, -1, &statement, nullptr);
+  }
+  ~Insert() { sqlite3_finalize(statement); }
+
+  Insert &bind(const string &value) {
+    sqlite3_bind_text(statement, ++column, value.data(), value.size(),
+                      SQLITE_TRANSIENT);
+    return *this;
+  }
+  Insert &bind(int value) {
+    sqlite3_bind_int(statement, ++column, value);
+    return *this;
+  }
+
+  bool run() {
+    column = 0;
+    bool done = statement && sqlite3_step(statement) == SQLITE_DONE;
+    sqlite3_reset(statement);
+    return done;
+  }
+
+private:
+  sqlite3_stmt *statement = nullptr;
+  int column = 0;
+};
+
+string toString(Interval interval) {
+  ostringstream out;
+  out << interval;
+  return out.str();
+}
+
+} // namespace
+
+static bool insertRows(sqlite3 *db, const ErrorResults &results) {
+  bool ok = true;
+
+  Insert spec(db, "INSERT INTO specs VALUES (?, ?)");
+  for (const auto &kv : results.specs) {
+    ok = spec.bind(kv.first).bind(toString(kv.second.interval)).run() && ok;
+  }
+
+  Insert edge(db, "INSERT INTO propagation VALUES (?, ?)");
+  for (const auto &kv : results.error_propagation) {
+    ok = edge.bind(kv.first).bind(kv.second).run() && ok;
+  }
+
+  Insert bootstrap(db, "INSERT INTO error_only_bootstrap VALUES (?)");
+  for (const string &fname : results.error_only_bootstrap) {
+    ok = bootstrap.bind(fname).run() && ok;
+  }
+
+  Insert counts(db, "INSERT INTO call_counts VALUES (?, ?, ?)");
+  for (const auto &kv : results.checked_calls) {
+    auto unchecked = results.unchecked_calls.find(kv.first);
+    int unchecked_count =
+        unchecked == results.unchecked_calls.end() ? 0 : unchecked->second;
+    ok = counts.bind(kv.first).bind(kv.second).bind(unchecked_count).run() &&
+         ok;
+  }
+
+  Insert call(db, "INSERT INTO unchecked_calls VALUES (?, ?)");
+  for (const auto &kv : results.unchecked_locs) {
+    ok = call.bind(kv.second).bind(kv.first).run() && ok;
+  }
+
+  Insert report(db, "INSERT INTO error_only_reports VALUES (?, ?, ?, ?, ?)");
+  for (const MissingChecks::ErrorOnlyReport &r : results.error_only_reports) {
+    ok = report.bind(r.location)
+             .bind(r.success.fname)
+             .bind(toString(r.success.interval))
+             .bind(r.error_spec.fname)
+             .bind(toString(r.error_spec.interval))
+             .run() &&
+         ok;
+  }
+
+  return ok;
+}
+
+bool writeErrorDatabase(const string &path, const ErrorResults &results,
+                        string &error) {
+  // Written next to path and renamed over it once complete, so a failed or
+  // interrupted run leaves the previous database in place
+  string tmp_path = path + ".tmp";
+  remove(tmp_path.c_str());
+
+  sqlite3 *db = nullptr;
+  if (sqlite3_open(tmp_path.c_str(), &db) != SQLITE_OK) {
+    error = db ? sqlite3_errmsg(db) : "out of memory";
+    sqlite3_close(db);
+    remove(tmp_path.c_str());
+    return false;
+  }
+
+  // The database is written from scratch in one transaction, so there is
+  // nothing to recover if the run is interrupted
+  sqlite3_exec(db, "PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF;",
+               nullptr, nullptr, nullptr);
+
+  bool ok = sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr) == SQLITE_OK &&
+            sqlite3_exec(db, schema, nullptr, nullptr, nullptr) == SQLITE_OK &&
+            insertRows(db, results) &&
+            sqlite3_exec(db, indexes, nullptr, nullptr, nullptr) == SQLITE_OK &&
+            sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) == SQLITE_OK;
+  if (!ok) {
+    error = sqlite3_errmsg(db);
+  }
+  if (sqlite3_close(db) != SQLITE_OK && ok) {
+    error = "cannot close " + tmp_path;
+    ok = false;
+  }
+
+  if (ok && rename(tmp_path.c_str(), path.c_str()) != 0) {
+    error = "cannot rename " + tmp_path + ": " + strerror(errno);
+    ok = false;
+  }
+  if (!ok) {
+    remove(tmp_path.c_str());
+  }
+  return ok;
+}
+
+} // namespace errspec
@@ -0,0 +1,54 @@
+// Writes the results of the errdb command to an SQLite database, so that
+// they can be queried instead of parsing the text output of each command.
+//
+// Tables:
+//
+//   specs(function, spec)                    the specs command
+//   propagation(source, target)              the errorpropagation edges
+//   error_only_bootstrap(function)           functions that call an
+//                                            error-only function
+//   call_counts(function, checked, unchecked)
+//                                            calls to each function with a
+//                                            spec, by whether they are checked
+//   unchecked_calls(location, function)      unchecked calls with debug info
+//   error_only_reports(location, function, spec, error_only,
+//                      error_only_spec)      error-only calls right after a
+//                                            successful call
+//
+// The view bugs(location, function, unchecked, checked) has the rows of the
+// bugs command.
+
+#ifndef ERRORDATABASE_H
+#define ERRORDATABASE_H
+
+#include "Constraint.h"
+#include "MissingChecks.h"
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace errspec {
+
+struct ErrorResults {
+  std::unordered_map<std::string, Constraint> specs;
+  std::set<std::pair<std::string, std::string>> error_propagation;
+  std::unordered_set<std::string> error_only_bootstrap;
+
+  std::unordered_map<std::string, int> checked_calls;
+  std::unordered_map<std::string, int> unchecked_calls;
+  // Function and location
+  std::vector<std::pair<std::string, std::string>> unchecked_locs;
+  std::vector<MissingChecks::ErrorOnlyReport> error_only_reports;
+};
+
+// Replaces the database at path with results, in one transaction. Returns
+// false and sets error if it cannot be written, leaving path as it was.
+bool writeErrorDatabase(const std::string &path, const ErrorResults &results,
+                        std::string &error);
+
+} // namespace errspec
+
+#endif
@@ -0,0 +1,112 @@
+#include "ErrorModels.h"
+#include <fstream>
+#include <sstream>
+
+using namespace llvm;
+using namespace std;
+using namespace errspec;
+
+namespace errspec {
+
+static const char *kind_names[] = {"none", "passthrough", "errortest",
+                                   "errorconstructor"};
+
+vector<ModelRule> defaultErrorModels() {
+  return {{ModelKind::ErrorConstructor, "*ERR_PTR*"},
+          {ModelKind::ErrorTest, "*IS_ERR*"},
+          {ModelKind::PassThrough, "*PTR_ERR*"},
+          {ModelKind::PassThrough, "*ERR_CAST*"}};
+}
+
+bool readErrorModelsFile(const string &path, vector<ModelRule> &rules) {
+  ifstream models_file(path);
+  if (!models_file) {
+    return false;
+  }
+
+  string line;
+  while (getline(models_file, line)) {
+    istringstream fields(line);
+    string kind, pattern;
+    if (!(fields >> kind) || kind[0] == '#') {
+      continue;
+    }
+    fields >> pattern;
+
+    ModelRule rule = {ModelKind::None, pattern};
+    for (unsigned i = 1; i < 4; ++i) {
+      if (kind == kind_names[i]) {
+        rule.kind = static_cast<ModelKind>(i);
+      }
+    }
+    if (rule.kind == ModelKind::None || pattern.empty()) {
+      return false;
+    }
+    rules.push_back(rule);
+  }
+
+  return true;
+}
+
+vector<string> formatErrorModels(const vector<ModelRule> &rules) {
+  vector<string> lines;
+  for (const ModelRule &rule : rules) {
+    lines.push_back(string(kind_names[static_cast<unsigned>(rule.kind)]) +
+                    " " + rule.pattern);
+  }
+  return lines;
+}
+
+// On a mismatch, the last '*' takes one more character and matching resumes
+// after it
+bool matchesPattern(const string &pattern, StringRef name) {
+  size_t p = 0, n = 0;
+  size_t star = string::npos, star_n = 0;
+  while (n < name.size()) {
+    if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      star_n = n;
+    } else if (p < pattern.size() && pattern[p] == name[n]) {
+      ++p;
+      ++n;
+    } else if (star != string::npos) {
+      p = star + 1;
+      n = ++star_n;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    ++p;
+  }
+  return p == pattern.size();
+}
+
+} // namespace errspec
+
+bool ErrorModels::runOnModule(Module &M) {
+  models.clear();
+  for (const Function &F : M) {
+    for (const ModelRule &rule : rules) {
+      if (matchesPattern(rule.pattern, F.getName())) {
+        models[&F] = rule.kind;
+        break;
+      }
+    }
+  }
+  return false;
+}
+
+ModelKind ErrorModels::getModel(const CallInst &call) const {
+  return getModel(
+      dyn_cast<Function>(call.getCalledValue()->stripPointerCasts()));
+}
+
+void ErrorModels::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+}
+
+char ErrorModels::ID = 0;
+static RegisterPass<ErrorModels>
+    X("error-models", "Models of the functions that handle error values",
+      false, true);
@@ -0,0 +1,81 @@
+// Models of the functions a project uses to build, test and pass along
+// error values, such as ERR_PTR, IS_ERR and PTR_ERR in Linux.
+//
+// Models file: "kind pattern" per line, where kind is one of
+// - errorconstructor: returns an error value built from its first argument
+// - errortest: tests whether its first argument is an error value
+// - passthrough: returns its first argument, possibly converted
+// A pattern is a function name in which '*' matches any characters, so
+// "*ERR_PTR*" also matches the copies LLVM numbers, like ERR_PTR116. The
+// first rule that matches a name applies. Empty lines and lines starting
+// with '#' are skipped.
+//
+// The rules are matched against the names of the functions of a module once,
+// and the transfer functions look up the model of a callee in a map.
+
+#ifndef ERRORMODELS_H
+#define ERRORMODELS_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace errspec {
+
+enum class ModelKind : uint8_t {
+  None,
+  PassThrough,
+  ErrorTest,
+  ErrorConstructor
+};
+
+struct ModelRule {
+  ModelKind kind;
+  std::string pattern;
+};
+
+// The Linux models, used when no models file is given
+std::vector<ModelRule> defaultErrorModels();
+
+// Returns false if a line has an unknown kind
+bool readErrorModelsFile(const std::string &path,
+                         std::vector<ModelRule> &rules);
+
+// One "kind pattern" line per rule, in order
+std::vector<std::string> formatErrorModels(const std::vector<ModelRule> &rules);
+
+bool matchesPattern(const std::string &pattern, llvm::StringRef name);
+
+} // namespace errspec
+
+class ErrorModels : public llvm::ModulePass {
+public:
+  static char ID;
+
+  ErrorModels() : ErrorModels(errspec::defaultErrorModels()) {}
+  explicit ErrorModels(std::vector<errspec::ModelRule> rules)
+      : llvm::ModulePass(ID), rules(std::move(rules)) {}
+
+  bool runOnModule(llvm::Module &M) override;
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  // None for indirect calls and functions without a model
+  errspec::ModelKind getModel(const llvm::CallInst &call) const;
+  errspec::ModelKind getModel(const llvm::Function *F) const {
+    auto it = models.find(F);
+    return it == models.end() ? errspec::ModelKind::None : it->second;
+  }
+
+private:
+  std::vector<errspec::ModelRule> rules;
+
+  // Only the functions with a model
+  llvm::DenseMap<const llvm::Function *, errspec::ModelKind> models;
+};
+
+#endif
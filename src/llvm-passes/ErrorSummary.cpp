@@ -0,0 +1,190 @@
+#include "ErrorSummary.h"
+#include "ErrorBlocks.h"
+#include <boost/algorithm/string.hpp>
+#include <cerrno>
+#include <cstdlib>
+#include <map>
+
+using namespace std;
+
+namespace errspec {
+
+void writeSummaries(const vector<FunctionSummary> &summaries, ostream &out) {
+  for (const FunctionSummary &summary : summaries) {
+    out << "function " << summary.name << "\n";
+    for (int64_t v : summary.error_values) {
+      out << "errorvalue " << v << "\n";
+    }
+    if (summary.error_only_call) {
+      out << "erroronly\n";
+    }
+    for (const GuardedReturn &r : summary.returns) {
+      out << "return " << r.guard << " " << r.guard_interval << " " << r.value
+          << " " << (r.callee.empty() ? "-" : r.callee) << "\n";
+    }
+  }
+}
+
+static bool parseValue(const string &field, int64_t &value) {
+  if (field.empty()) {
+    return false;
+  }
+  char *end;
+  errno = 0;
+  value = strtoll(field.c_str(), &end, 10);
+  return *end == '\0' && errno == 0;
+}
+
+bool readSummaries(istream &in, vector<FunctionSummary> &summaries) {
+  FunctionSummary *current = nullptr;
+  string line;
+  while (getline(in, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    vector<string> fields;
+    boost::split(fields, line, boost::is_any_of(" "));
+
+    if (fields[0] == "function" && fields.size() == 2) {
+      summaries.emplace_back();
+      current = &summaries.back();
+      current->name = fields[1];
+    } else if (!current) {
+      return false;
+    } else if (fields[0] == "errorvalue" && fields.size() == 2) {
+      int64_t value;
+      if (!parseValue(fields[1], value)) {
+        return false;
+      }
+      current->error_values.insert(value);
+    } else if (fields[0] == "erroronly" && fields.size() == 1) {
+      current->error_only_call = true;
+    } else if (fields[0] == "return" && fields.size() == 5) {
+      GuardedReturn r;
+      r.guard = fields[1];
+      if (!parseInterval(fields[2], r.guard_interval) ||
+          !parseInterval(fields[3], r.value)) {
+        return false;
+      }
+      if (fields[4] != "-") {
+        r.callee = fields[4];
+      }
+      current->returns.insert(r);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Rules are solved with a worklist over functions in name order. When the
+// specification of a function changes, the functions with a rule that reads
+// it are revisited. Specifications only grow, so the fixpoint is the one
+// ErrorBlocks reaches on the linked module. An edge is recorded when a rule
+// that propagates from another function changes a specification, as in
+// ErrorBlocks, so the edges can differ from those of a whole-program run in
+// which the rules fired in another order.
+LinkedSpecs
+linkSummaries(const vector<FunctionSummary> &summaries,
+              const unordered_map<string, Constraint> &input_specs) {
+  map<string, FunctionSummary> merged;
+  for (const FunctionSummary &summary : summaries) {
+    FunctionSummary &m = merged[summary.name];
+    m.name = summary.name;
+    m.error_values.insert(summary.error_values.begin(),
+                          summary.error_values.end());
+    m.error_only_call = m.error_only_call || summary.error_only_call;
+    m.returns.insert(summary.returns.begin(), summary.returns.end());
+  }
+
+  LinkedSpecs linked;
+  unordered_map<string, Constraint> &specs = linked.specs;
+  specs = input_specs;
+
+  // Joins interval into the specification of fname. Returns true if it
+  // changed.
+  auto join = [&](const string &fname, Interval interval) {
+    auto it = specs.find(fname);
+    if (it == specs.end()) {
+      Constraint c(fname);
+      c.interval = interval;
+      specs[fname] = c;
+      return true;
+    }
+    Interval old = it->second.interval;
+    it->second.interval = joinIntervals(old, interval);
+    return it->second.interval != old;
+  };
+
+  vector<const FunctionSummary *> functions;
+  unordered_map<string, vector<unsigned>> readers;
+  for (const auto &kv : merged) {
+    const FunctionSummary &summary = kv.second;
+    unsigned idx = functions.size();
+    functions.push_back(&summary);
+
+    if (summary.error_only_call) {
+      linked.error_only_bootstrap.insert(summary.name);
+    }
+    for (int64_t v : summary.error_values) {
+      join(summary.name, ErrorBlocks::abstractInteger(v));
+    }
+
+    set<string> read;
+    for (const GuardedReturn &r : summary.returns) {
+      read.insert(r.guard);
+      if (!r.callee.empty()) {
+        read.insert(r.callee);
+      }
+    }
+    for (const string &fname : read) {
+      readers[fname].push_back(idx);
+    }
+  }
+
+  set<unsigned> worklist;
+  for (unsigned i = 0, e = functions.size(); i != e; ++i) {
+    worklist.insert(i);
+  }
+
+  while (!worklist.empty()) {
+    const FunctionSummary &summary = *functions[*worklist.begin()];
+    worklist.erase(worklist.begin());
+
+    bool function_changed = false;
+    for (const GuardedReturn &r : summary.returns) {
+      auto guard = specs.find(r.guard);
+      if (guard == specs.end() ||
+          meetIntervals(r.guard_interval, guard->second.interval) ==
+              Interval::BOT) {
+        continue;
+      }
+
+      Interval value = r.value;
+      string propagate_callee = value != Interval::BOT ? r.guard : "";
+      auto callee = r.callee.empty() ? specs.end() : specs.find(r.callee);
+      if (callee != specs.end()) {
+        value = callee->second.interval;
+        propagate_callee = r.callee;
+      }
+
+      bool changed = join(summary.name, value);
+      if (changed && !propagate_callee.empty()) {
+        linked.error_propagation.insert(
+            make_pair(propagate_callee, summary.name));
+      }
+      function_changed = function_changed || changed;
+    }
+
+    if (function_changed) {
+      auto it = readers.find(summary.name);
+      if (it != readers.end()) {
+        worklist.insert(it->second.begin(), it->second.end());
+      }
+    }
+  }
+
+  return linked;
+}
+
+} // namespace errspec
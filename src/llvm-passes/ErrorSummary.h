@@ -0,0 +1,93 @@
+// Per-function summaries of ErrorBlocks, for inferring specifications across
+// modules that are analyzed separately.
+//
+// What ErrorBlocks finds in a function splits into facts that hold whatever
+// the specifications of other functions are, and rules that only fire once
+// the specification of a callee is known:
+//
+// error_values: constants returned after a call to an error-only function,
+//               or returned error codes. They are always error values.
+// returns: a block constrained by the return value of guard (to
+//          guard_interval) returns value, a constant abstracted to an
+//          interval, or the result of a call to callee. When the
+//          specification of guard meets guard_interval, the specification
+//          of callee (if it has one) or value is joined into the function's.
+//
+// The summaries of every module are linked by solving these rules to a
+// fixpoint over the whole program, without the bitcode.
+//
+// Text format, one record per line. The records after a function line belong
+// to that function:
+//
+//   function NAME
+//   errorvalue CONSTANT
+//   erroronly
+//   return GUARD GUARD_INTERVAL VALUE_INTERVAL CALLEE
+//
+// CALLEE is "-" if the block does not return the result of a call.
+
+#ifndef ERRORSUMMARY_H
+#define ERRORSUMMARY_H
+
+#include "Constraint.h"
+#include <iostream>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace errspec {
+
+struct GuardedReturn {
+  std::string guard;
+  Interval guard_interval = Interval::BOT;
+  Interval value = Interval::BOT;
+  std::string callee;
+
+  bool operator<(const GuardedReturn &other) const {
+    return std::tie(guard, guard_interval, value, callee) <
+           std::tie(other.guard, other.guard_interval, other.value,
+                    other.callee);
+  }
+};
+
+struct FunctionSummary {
+  std::string name;
+  std::set<int64_t> error_values;
+
+  // Calls an error-only function
+  bool error_only_call = false;
+
+  std::set<GuardedReturn> returns;
+
+  bool empty() const {
+    return error_values.empty() && !error_only_call && returns.empty();
+  }
+};
+
+void writeSummaries(const std::vector<FunctionSummary> &summaries,
+                    std::ostream &out);
+
+// Appends the summaries in in to summaries. Returns false on a malformed
+// line.
+bool readSummaries(std::istream &in, std::vector<FunctionSummary> &summaries);
+
+// The specifications, error propagation edges and error-only bootstrap
+// functions of the linked program, as ErrorBlocks reports them for a module
+struct LinkedSpecs {
+  std::unordered_map<std::string, Constraint> specs;
+  std::set<std::pair<std::string, std::string>> error_propagation;
+  std::unordered_set<std::string> error_only_bootstrap;
+};
+
+// Summaries of functions with the same name are merged. Input specs seed the
+// specifications, as in ErrorBlocks.
+LinkedSpecs
+linkSummaries(const std::vector<FunctionSummary> &summaries,
+              const std::unordered_map<std::string, Constraint> &input_specs);
+
+} // namespace errspec
+
+#endif
@@ -0,0 +1,27 @@
+#include "FunctionIds.h"
+
+using namespace std;
+
+namespace errspec {
+
+FunctionId FunctionIds::intern(const string &name) {
+  auto it = ids.find(name);
+  if (it != ids.end()) {
+    return it->second;
+  }
+  FunctionId id = names.size();
+  ids[name] = id;
+  names.push_back(name);
+  return id;
+}
+
+bool FunctionIds::lookup(const string &name, FunctionId &id) const {
+  auto it = ids.find(name);
+  if (it == ids.end()) {
+    return false;
+  }
+  id = it->second;
+  return true;
+}
+
+} // namespace errspec
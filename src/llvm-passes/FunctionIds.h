@@ -0,0 +1,40 @@
+// Dense integer ids for the names of called functions in a module.
+//
+// Dataflow facts refer to callees by FunctionId instead of by name, so that
+// copying and comparing facts does not touch strings. Names are recovered with
+// getName when results are reported. Ids are handed out in module order by
+// CallSiteIndex, which also resolves every call to the id of its callee,
+// before any analysis runs; afterwards the table is only read and may be
+// shared between threads.
+
+#ifndef FUNCTIONIDS_H
+#define FUNCTIONIDS_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace errspec {
+
+typedef uint32_t FunctionId;
+
+class FunctionIds {
+public:
+  FunctionId intern(const std::string &name);
+
+  // Sets id to the id of name. Returns false if name has no id.
+  bool lookup(const std::string &name, FunctionId &id) const;
+
+  const std::string &getName(FunctionId id) const { return names.at(id); }
+
+  size_t size() const { return names.size(); }
+
+private:
+  std::unordered_map<std::string, FunctionId> ids;
+  std::vector<std::string> names;
+};
+
+} // namespace errspec
+
+#endif
@@ -0,0 +1,55 @@
+#include "InstructionNumbering.h"
+#include "LazyModule.h"
+
+using namespace llvm;
+using namespace std;
+
+bool InstructionNumbering::runOnModule(Module &M) {
+  instruction_numbers.clear();
+  block_numbers.clear();
+  block_first.clear();
+  block_end.clear();
+
+  // The numbers of a body dropped by loadModuleLazily are skipped
+  unsigned number = 0;
+  for (Function &F : M) {
+    number += errspec::droppedInstructions(F);
+    for (BasicBlock &BB : F) {
+      block_numbers[&BB] = block_first.size();
+      block_first.push_back(number);
+      for (Instruction &I : BB) {
+        instruction_numbers[&I] = number++;
+      }
+      block_end.push_back(number);
+    }
+  }
+  num_instructions = number;
+
+  return false;
+}
+
+bool InstructionNumbering::contains(const Value *v) const {
+  const Instruction *I = dyn_cast<Instruction>(v);
+  return I && instruction_numbers.count(I);
+}
+
+unsigned InstructionNumbering::getNumber(const Instruction *I) const {
+  auto it = instruction_numbers.find(I);
+  assert(it != instruction_numbers.end() && "instruction not in module");
+  return it->second;
+}
+
+unsigned InstructionNumbering::getBlockNumber(const BasicBlock *BB) const {
+  auto it = block_numbers.find(BB);
+  assert(it != block_numbers.end() && "block not in module");
+  return it->second;
+}
+
+void InstructionNumbering::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+}
+
+char InstructionNumbering::ID = 0;
+static RegisterPass<InstructionNumbering>
+    X("instruction-numbering", "Dense numbers for instructions and blocks",
+      false, true);
@@ -0,0 +1,62 @@
+// Dense numbers for the instructions and blocks of a module.
+//
+// Instructions are numbered 0..numInstructions()-1 in module order, so the
+// instructions of a block, and the blocks of a function, get consecutive
+// numbers. Passes use the numbers as slots into flat vectors (see FactTable
+// in Dataflow.hpp) instead of hashing Value pointers. Within a block the slot
+// of the next instruction is the current slot plus one, so walking a block
+// needs one lookup for the whole block.
+//
+// A function whose body was dropped by loadModuleLazily (see LazyModule.h)
+// keeps the numbers of its instructions as a gap, so that the distance
+// between two instructions is the same as when every body is read.
+
+#ifndef INSTRUCTIONNUMBERING_H
+#define INSTRUCTIONNUMBERING_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include <vector>
+
+class InstructionNumbering : public llvm::ModulePass {
+public:
+  static char ID;
+
+  InstructionNumbering() : llvm::ModulePass(ID) {}
+
+  bool runOnModule(llvm::Module &M) override;
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  bool contains(const llvm::Value *v) const;
+
+  unsigned getNumber(const llvm::Instruction *I) const;
+  unsigned getBlockNumber(const llvm::BasicBlock *BB) const;
+
+  // Numbers of the first and last instruction of BB
+  unsigned getFirst(const llvm::BasicBlock *BB) const {
+    return block_first[getBlockNumber(BB)];
+  }
+  unsigned getLast(const llvm::BasicBlock *BB) const {
+    return block_end[getBlockNumber(BB)] - 1;
+  }
+
+  // One more than the highest number, counting the gaps
+  unsigned numInstructions() const { return num_instructions; }
+  unsigned numBlocks() const { return block_numbers.size(); }
+
+private:
+  llvm::DenseMap<const llvm::Instruction *, unsigned> instruction_numbers;
+  llvm::DenseMap<const llvm::BasicBlock *, unsigned> block_numbers;
+
+  // Number of the first instruction of each block and one past its last, by
+  // block number
+  std::vector<unsigned> block_first;
+  std::vector<unsigned> block_end;
+
+  unsigned num_instructions = 0;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "LazyModule.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/Error.h"
+#include <glog/logging.h>
+
+using namespace llvm;
+using namespace std;
+
+namespace errspec {
+
+// Attached to the declarations left by dropped bodies
+static const char *dropped_kind = "eesi.dropped";
+
+unique_ptr<Module> loadModuleLazily(const string &path, SMDiagnostic &err,
+                                    LLVMContext &context, BodyFilter keep) {
+  // Metadata is also read on demand, for the bodies that are kept
+  unique_ptr<Module> M = getLazyIRFileModule(path, err, context, true);
+  if (!M) {
+    return nullptr;
+  }
+
+  uint64_t kept = 0;
+  uint64_t dropped = 0;
+  for (Function &F : *M) {
+    if (!F.isMaterializable()) {
+      continue;
+    }
+    if (Error e = F.materialize()) {
+      err = SMDiagnostic(path, SourceMgr::DK_Error, toString(move(e)));
+      return nullptr;
+    }
+    if (keep(F)) {
+      ++kept;
+    } else {
+      unsigned instructions = 0;
+      for (const BasicBlock &BB : F) {
+        instructions += BB.size();
+      }
+      // deleteBody clears the metadata of F, so the count is attached after
+      F.deleteBody();
+      Metadata *count = ConstantAsMetadata::get(
+          ConstantInt::get(Type::getInt32Ty(context), instructions));
+      F.setMetadata(dropped_kind, MDNode::get(context, count));
+      ++dropped;
+    }
+  }
+
+  // Reads whatever is left, such as global metadata, and runs the upgrades
+  // that parseIRFile would have run
+  if (Error e = M->materializeAll()) {
+    err = SMDiagnostic(path, SourceMgr::DK_Error, toString(move(e)));
+    return nullptr;
+  }
+
+  LOG(INFO) << "Kept " << kept << " function bodies and dropped " << dropped;
+  return M;
+}
+
+unsigned droppedInstructions(const Function &F) {
+  const MDNode *node = F.getMetadata(dropped_kind);
+  if (!node) {
+    return 0;
+  }
+  return mdconst::extract<ConstantInt>(node->getOperand(0))->getZExtValue();
+}
+
+} // namespace errspec
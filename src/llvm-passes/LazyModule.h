@@ -0,0 +1,41 @@
+// Loading bitcode one function body at a time.
+//
+// parseIRFile reads every function body up front. loadModuleLazily instead
+// reads the module with its bodies left in the bitcode, then reads the bodies
+// one at a time and asks keep whether the analyses will need each one. The
+// bodies that are not needed are dropped right after they are read, so the
+// function becomes a declaration and only the kept bodies are ever resident
+// together.
+//
+// A dropped function remembers how many instructions its body had, so that
+// InstructionNumbering can leave a gap for it and distances in module order
+// stay what they are when every body is read.
+
+#ifndef LAZYMODULE_H
+#define LAZYMODULE_H
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace errspec {
+
+typedef std::function<bool(const llvm::Function &)> BodyFilter;
+
+// Returns null and sets err if the file cannot be read
+std::unique_ptr<llvm::Module> loadModuleLazily(const std::string &path,
+                                               llvm::SMDiagnostic &err,
+                                               llvm::LLVMContext &context,
+                                               BodyFilter keep);
+
+// The number of instructions of F's body if loadModuleLazily dropped it,
+// otherwise 0
+unsigned droppedInstructions(const llvm::Function &F);
+
+} // namespace errspec
+
+#endif
@@ -1,17 +1,23 @@
 #include "MissingChecks.h"
+#include "CallSiteIndex.h"
 #include "Common.h"
+#include "LazyModule.h"
+#include "ErrorBlocks.h"
+#include "Parallel.hpp"
+#include "InstructionNumbering.h"
 #include "ReturnPropagationPointer.h"
 #include "ReturnConstraintsPointer.h"
+#include "SpecFiles.h"
+#include "SpecSnapshot.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
-#include <boost/algorithm/string.hpp>
 #include <glog/logging.h>
 #include <iostream>
 #include <string>
-#include <fstream>
+#include <sstream>
 
 using namespace llvm;
 using namespace std;
@@ -20,85 +26,254 @@ using namespace errspec;
 // If set to true, then bugs in void returning functions are filtered out
 #define VOIDFILTER false
 
+// A call to an error-only function is only reported if the call whose success
+// it follows is at most this many instructions before it
+#define MAX_CALL_DISTANCE 25
+
 // The return value must be checked or propagated, and there must exist an error
 // handling block for the function in the same parent. False negatives if >1
 // call to same function, both checked, and one has an insufficient check.
 
+MissingChecks::MissingChecks(string specs_path, string error_only_path,
+                             string debug_function, unsigned jobs)
+    : MissingChecks(SpecSnapshot::isSnapshot(specs_path)
+                        ? unordered_map<string, Constraint>()
+                        : readSpecsFile(specs_path),
+                    readErrorOnlyFile(error_only_path), debug_function, jobs) {
+  if (SpecSnapshot::isSnapshot(specs_path)) {
+    string error;
+    spec_snapshot = SpecSnapshot::open(specs_path, error);
+    if (!spec_snapshot) {
+      cerr << "WARNING: " << specs_path << ": " << error << "\n";
+    }
+  }
+  if (function_specs.empty() && (!spec_snapshot || !spec_snapshot->size())) {
+    cerr << "WARNING: EMPTY INPUT SPECS LIST!\n";
+  }
+  if (error_only.empty()) {
+    cerr << "WARNING: EMPTY ERROR-ONLY SET!\n";
+  }
+}
+
 bool MissingChecks::runOnModule(llvm::Module &M) {
-  readSpecsFile();
-  readErrorOnlyFile();
+  if (spec_source) {
+    function_specs = spec_source->getErrorReturnValues();
+    spec_snapshot.reset();
+  }
 
   LOG(INFO) << "Running bugchecker...";
 
   return_propagation = &getAnalysis<ReturnPropagationPointer>();
-
+  return_constraints = &getAnalysis<ReturnConstraintsPointer>();
+  numbering = &getAnalysis<InstructionNumbering>();
+  call_sites = &getAnalysis<CallSiteIndex>();
+
+  // Callee names are looked up once here, and per call as a flag
+  call_sites->markCallees(CallSiteIndex::ErrorOnly, error_only);
+  call_sites->markCallees(CallSiteIndex::HasSpec, [this](const string &fname) {
+    Constraint spec;
+    return findSpec(fname, spec);
+  });
+
+  // Entries are created up front so that functions can be indexed, and call
+  // sites checked, on different threads. Functions out of scope have no
+  // facts; their results are taken from cached_results.
+  vector<Function *> functions;
+  vector<CallInst *> calls;
   for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-    Function *f = &*fi;
+    if (!scope.contains(*fi)) {
+      continue;
+    }
+    functions.push_back(&*fi);
+    function_checks[&*fi];
+    function_results[&*fi];
     for (auto bi = fi->begin(), be = fi->end(); bi != be; ++bi) {
       for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
-        instruction_numbers[&(*ii)] = next_inst_num++;
+        if (CallInst *call = dyn_cast<CallInst>(&(*ii))) {
+          calls.push_back(call);
+        }
       }
     }
   }
 
+  parallelFor(jobs, functions.size(), [&](size_t i) {
+    indexChecks(*functions[i], function_checks.at(functions[i]));
+  });
+
+  vector<CallSiteResult> results(calls.size());
+  parallelFor(jobs, calls.size(),
+              [&](size_t i) { visitCallInst(calls[i], results[i]); });
+  for (size_t i = 0; i < calls.size(); ++i) {
+    function_results.at(calls[i]->getParent()->getParent())
+        .push_back(std::move(results[i]));
+  }
+
+  // Merged in module order so that the output does not depend on jobs
   for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-    Function *f = &*fi;
-    for (auto bi = fi->begin(), be = fi->end(); bi != be; ++bi) {
-      for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
-        if (CallInst *call = dyn_cast<CallInst>(&(*ii))) {
-          visitCallInst(call);
-        }
-      }
+    const auto &results_by_function =
+        scope.contains(*fi) ? function_results : cached_results;
+    auto function_result = results_by_function.find(&*fi);
+    if (function_result == results_by_function.end()) {
+      continue;
+    }
+    for (const CallSiteResult &result : function_result->second) {
+      mergeResult(result);
     }
   }
 
   for (auto ul : unchecked_locs) {
     string fname = ul.first;
     string loc = ul.second;
-    cout << loc << " " << fname << " " << unchecked_calls.at(fname) << " "
-         << checked_calls.at(fname) << endl;
+    *output << loc << " " << fname << " " << unchecked_calls.at(fname) << " "
+            << checked_calls.at(fname) << endl;
   }
+
+  return false;
 }
 
-void MissingChecks::readSpecsFile() {
-  string line;
+void MissingChecks::mergeResult(const CallSiteResult &result) {
+  if (result.has_error_only_report) {
+    *output << formatReport(result.error_only_report) << endl;
+    error_only_reports.push_back(result.error_only_report);
+  }
+  if (result.fname.empty()) {
+    return;
+  }
 
-  // Read input specifications from text file line by line
-  ifstream specs_file(specs_path);
-  bool have_specs = false;
-  while (getline(specs_file, line)) {
-    have_specs = true;
-    // need to split fname from spec
-    vector<string> fields;
-    boost::split(fields, line, boost::is_any_of(" "));
-    string fname = fields[1];
-    Constraint c(fname, fields[2]);
-    function_specs[fname] = c;
+  const string &fname = result.fname;
+  if (checked_calls.find(fname) == checked_calls.end()) {
+    checked_calls[fname] = 0;
+  }
+  if (unchecked_calls.find(fname) == unchecked_calls.end()) {
+    unchecked_calls[fname] = 0;
   }
 
-  if (!have_specs) {
-    cerr << "WARNING: EMPTY INPUT SPECS LIST!\n";
+  if (result.checked) {
+    checked_calls[fname] = checked_calls[fname] + 1;
+  } else if (!result.unchecked_loc.empty()) {
+    unchecked_calls[fname] = unchecked_calls[fname] + 1;
+    unchecked_locs.push_back(make_pair(fname, result.unchecked_loc));
   }
 }
 
-void MissingChecks::readErrorOnlyFile() {
-  string line;
+const vector<MissingChecks::CallSiteResult> &
+MissingChecks::getResults(const Function &F) const {
+  return function_results.at(&F);
+}
 
-  // Read error-only functions from text file line by line
-  // and insert them into the set of error-only functions.
-  ifstream error_only_file(error_only_path);
-  while (getline(error_only_file, line)) {
-    error_only.insert(line);
+void MissingChecks::writeResults(const vector<CallSiteResult> &results,
+                                 ostream &out) {
+  for (const CallSiteResult &result : results) {
+    if (result.has_error_only_report) {
+      out << "report " << formatReport(result.error_only_report) << "\n";
+    }
+    if (!result.fname.empty()) {
+      out << "call " << result.fname << " " << result.checked << " "
+          << result.unchecked_loc << "\n";
+    }
   }
-  if (error_only.size() == 0) {
-    cerr << "WARNING: EMPTY ERROR-ONLY SET!\n";
+}
+
+// The window of the first instruction of F reaches furthest back
+vector<string> MissingChecks::callsBefore(const Function &F) {
+  vector<string> calls;
+  const Module &M = *F.getParent();
+  unsigned distance = 0;
+  for (auto fi = F.getIterator();
+       fi != M.begin() && distance < MAX_CALL_DISTANCE;) {
+    --fi;
+    // A dropped body had no calls that the window looks for, only length
+    distance += droppedInstructions(*fi);
+    const Function::BasicBlockListType &blocks = fi->getBasicBlockList();
+    for (auto bi = blocks.rbegin(), be = blocks.rend();
+         bi != be && distance < MAX_CALL_DISTANCE; ++bi) {
+      for (auto ii = bi->rbegin(), ie = bi->rend();
+           ii != ie && distance < MAX_CALL_DISTANCE; ++ii) {
+        ++distance;
+        if (const CallInst *call = dyn_cast<CallInst>(&*ii)) {
+          calls.push_back(to_string(distance) + " " + getCalleeName(*call));
+        }
+      }
+    }
   }
+  return calls;
+}
+
+string MissingChecks::formatReport(const ErrorOnlyReport &report) {
+  ostringstream out;
+  out << report.location << " " << report.success.fname << " "
+      << report.success.interval << " " << report.error_spec.fname << " "
+      << report.error_spec.interval;
+  return out.str();
 }
 
+// The location is everything before the last four fields, as it may hold
+// spaces
+static bool parseReport(const string &line,
+                        MissingChecks::ErrorOnlyReport &report) {
+  vector<string> fields;
+  size_t end = line.size();
+  for (int i = 0; i < 4; ++i) {
+    size_t space = end == 0 ? string::npos : line.rfind(' ', end - 1);
+    if (space == string::npos) {
+      return false;
+    }
+    fields.push_back(line.substr(space + 1, end - space - 1));
+    end = space;
+  }
+  report.location = line.substr(0, end);
+  report.success = Constraint(fields[3]);
+  report.error_spec = Constraint(fields[1]);
+  return parseInterval(fields[2], report.success.interval) &&
+         parseInterval(fields[0], report.error_spec.interval);
+}
+
+bool MissingChecks::readResults(istream &in, vector<CallSiteResult> &results) {
+  string line;
+  while (getline(in, line)) {
+    CallSiteResult result;
+    if (line.compare(0, 7, "report ") == 0) {
+      if (!parseReport(line.substr(7), result.error_only_report)) {
+        return false;
+      }
+      result.has_error_only_report = true;
+    } else if (line.compare(0, 5, "call ") == 0) {
+      size_t name_end = line.find(' ', 5);
+      if (name_end == string::npos || name_end + 2 >= line.size() ||
+          line[name_end + 2] != ' ') {
+        return false;
+      }
+      result.fname = line.substr(5, name_end - 5);
+      result.checked = line[name_end + 1] == '1';
+      result.unchecked_loc = line.substr(name_end + 3);
+    } else {
+      return false;
+    }
+    results.push_back(result);
+  }
+  return true;
+}
 
-void MissingChecks::visitCallInst(llvm::CallInst *I) {
-  ReturnConstraintsPointer &return_constraints = getAnalysis<ReturnConstraintsPointer>();
+// function_specs, or the snapshot if the specs were mapped from one
+bool MissingChecks::findSpec(const string &fname, Constraint &spec) const {
+  auto it = function_specs.find(fname);
+  if (it != function_specs.end()) {
+    spec = it->second;
+    return true;
+  }
+  Interval interval;
+  if (spec_snapshot && spec_snapshot->find(fname, interval)) {
+    spec = Constraint(fname);
+    spec.interval = interval;
+    return true;
+  }
+  return false;
+}
 
+// Only reads the finished dataflow facts and writes result, so call sites
+// can be visited concurrently
+void MissingChecks::visitCallInst(llvm::CallInst *I,
+                                  CallSiteResult &result) const {
   bool debug = false;
   Function *p = I->getParent()->getParent();
   string parent = p->getName();
@@ -106,35 +281,41 @@ void MissingChecks::visitCallInst(llvm::CallInst *I) {
     debug = true;
   }
 
-  Function *f = dyn_cast<Function>(I->getCalledValue()->stripPointerCasts());
-  if (!f)
+  const CallSiteIndex::CallInfo &info = call_sites->getCallInfo(*I);
+  if (!info.callee)
     return;
-  string fname = getCalleeName(*I);
+  const FunctionIds &function_ids = call_sites->getFunctionIds();
+  const string &fname = function_ids.getName(info.id);
 
   LOG_IF(INFO, debug) << "processing call to " << fname << " in " << debug_function;
 
-  if (error_only.find(fname) != error_only.end()) {
+  if (call_sites->hasFlag(info.id, CallSiteIndex::ErrorOnly)) {
     BasicBlock *bb = I->getParent();
     Instruction *bb_last = GetLastInstructionOfBB(bb);
-    ReturnConstraintsPointerFact rcf = return_constraints.getOutFact(bb_last);
+    ReturnConstraintsPointerFact rcf = return_constraints->getOutFact(bb_last);
 
     bool haveSuccess = false;
     bool haveNoError = true;
     Constraint success_constraint;
+    FunctionId success_id = 0;
     Constraint error_spec;
 
-    for (auto kv : rcf.value) {
-      string constraint_fname = kv.first;
-      Constraint block_constraint = kv.second;
+    for (auto &entry : rcf.value) {
+      if (!call_sites->hasFlag(entry.first, CallSiteIndex::HasSpec)) {
+        continue;
+      }
+      string constraint_fname = function_ids.getName(entry.first);
+      Constraint block_constraint(constraint_fname);
+      block_constraint.interval = entry.second;
 
-      if (function_specs.find(constraint_fname) == function_specs.end()) {
+      Constraint spec;
+      if (!findSpec(constraint_fname, spec)) {
         continue;
       }
       if (block_constraint.interval == Interval::TOP) {
         continue;
       }
 
-      Constraint spec = function_specs.at(block_constraint.fname);
       if (block_constraint.fname != spec.fname) {
         continue;
       }
@@ -142,6 +323,7 @@ void MissingChecks::visitCallInst(llvm::CallInst *I) {
       if (block_constraint.meet(spec).interval == Interval::BOT) {
         haveSuccess = true;
         success_constraint = block_constraint;
+        success_id = entry.first;
         error_spec = spec;
       }
       if (block_constraint.meet(spec).interval != Interval::BOT) {
@@ -157,38 +339,27 @@ void MissingChecks::visitCallInst(llvm::CallInst *I) {
         line = loc->getLine();
       }
 
-      bool short_distance_to_call = false;
-      Module &M = *(I->getParent()->getParent()->getParent());
-      for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-        Function *f = &*fi;
-        for (auto bi = fi->begin(), be = fi->end(); bi != be; ++bi) {
-          for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
-            if (CallInst *call = dyn_cast<CallInst>(&(*ii))) {
-              if (getCalleeName(*call) == success_constraint.fname) {
-                uint64_t call_instruction_number = instruction_numbers.at(call);
-                uint64_t eo_instruction_number = instruction_numbers.at(I);
-                if (eo_instruction_number - call_instruction_number <= 25) {
-                  short_distance_to_call = true;
-                }
-              }
-            }
-          }
-        }
-      }
+      unsigned eo_instruction_number = numbering->getNumber(I);
+      unsigned first = eo_instruction_number < MAX_CALL_DISTANCE
+                           ? 0
+                           : eo_instruction_number - MAX_CALL_DISTANCE;
+      bool short_distance_to_call =
+          call_sites->hasCallBetween(success_id, first, eo_instruction_number);
 
       if (short_distance_to_call) {
-        string loc = file + ":" + to_string(line);
-        cout << loc << " " << 
-          success_constraint.fname << " " << success_constraint.interval << " "
-          << error_spec.fname << " " << error_spec.interval << endl;
+        result.has_error_only_report = true;
+        result.error_only_report.location = file + ":" + to_string(line);
+        result.error_only_report.success = success_constraint;
+        result.error_only_report.error_spec = error_spec;
       }
     }
   }
 
-  if (function_specs.find(fname) == function_specs.end()) {
+  Constraint spec;
+  if (!call_sites->hasFlag(info.id, CallSiteIndex::HasSpec) ||
+      !findSpec(fname, spec)) {
     return;
   }
-  Constraint spec = function_specs.at(fname);
   if (spec.interval == Interval::TOP) {
     return;
   }
@@ -199,67 +370,87 @@ void MissingChecks::visitCallInst(llvm::CallInst *I) {
   // Set to true if we know we can't reason about this call (do not increment)
   bool filtered = false;
 
-  // Iterate over every instruction in the parent function
-  for (inst_iterator ii = inst_begin(*p), ie = inst_end(*p); ii != ie; ++ii) {
-    Instruction *inst = &*ii;
-    shared_ptr<ReturnPropagationPointerFact> input_fact = 
-      return_propagation->getInputFactAt(inst);
-    
-    if (ICmpInst *icmp = dyn_cast<ICmpInst>(inst)) {
-      LOG_IF(INFO, debug) << "potential check for " << fname;
-      if (checkIsSufficient(icmp, I)) {
-        checked = true;
-      }
-      LOG_IF(INFO, debug) << checked;
-
-    } else if (ReturnInst *ret = dyn_cast<ReturnInst>(inst)) {
-      if (inst->getNumOperands() > 0) {
-        Value *returned = inst->getOperand(0);
-        if (input_fact->valueMayHold(returned, I)) {
+  // Only the check-like instructions that test a value that may hold the
+  // return value of I need to be looked at
+  const FunctionChecks &checks = function_checks.at(p);
+  auto sites = checks.sites.find(I);
+  if (sites != checks.sites.end()) {
+    for (Instruction *inst : sites->second) {
+      if (ICmpInst *icmp = dyn_cast<ICmpInst>(inst)) {
+        LOG_IF(INFO, debug) << "potential check for " << fname;
+        if (checkIsSufficient(icmp, I)) {
           checked = true;
         }
-      }
-    } else if (CallInst *call = dyn_cast<CallInst>(inst)) {
-      string fname = getCalleeName(*call);
-      if (fname.find("IS_ERR") != string::npos) {
-        for (int i = 0; i < call->getNumArgOperands(); ++i) {
-          Value *op = call->getArgOperand(i);
-          if (input_fact->valueMayHold(op, I)) {
-            checked = true;
-          }
-        }
-      }
-    } else if (SwitchInst *swtch = dyn_cast<SwitchInst>(inst)) {
-      Value *op = swtch->getCondition();
-      if (input_fact->valueMayHold(op, I)) {
+        LOG_IF(INFO, debug) << checked;
+      } else {
         checked = true;
       }
     }
   }
 
-  if (VOIDFILTER && I->getParent()->getParent()->getReturnType()->isVoidTy()) {
-    filtered = true;
+  // With a bottom spec any icmp is sufficient, see checkIsSufficient
+  if (spec.interval == Interval::BOT && checks.has_icmp) {
+    checked = true;
   }
 
-  if (checked_calls.find(fname) == checked_calls.end()) {
-    checked_calls[fname] = 0;
-  }
-  if (unchecked_calls.find(fname) == unchecked_calls.end()) {
-    unchecked_calls[fname] = 0;
+  if (VOIDFILTER && I->getParent()->getParent()->getReturnType()->isVoidTy()) {
+    filtered = true;
   }
 
+  result.fname = fname;
   if (!checked && !filtered) {
     // Get the source location of the call and print that out
     if (DILocation *loc2 = I->getDebugLoc()) {
       string file2 = loc2->getFilename();
       unsigned line2 = loc2->getLine();
-      unchecked_calls[fname] = unchecked_calls[fname] + 1;
-      string sloc = file2 + ":" + to_string(line2);
-      unchecked_locs.push_back(make_pair(fname, sloc));
+      result.unchecked_loc = file2 + ":" + to_string(line2);
     }
 
   } else {
-    checked_calls[fname] = checked_calls[fname] + 1;
+    result.checked = true;
+  }
+}
+
+// Records, for every call in F, the check-like instructions whose operand
+// may hold its return value
+void MissingChecks::indexChecks(Function &F, FunctionChecks &checks) const {
+  for (inst_iterator ii = inst_begin(F), ie = inst_end(F); ii != ie; ++ii) {
+    Instruction *inst = &*ii;
+
+    // The values that inst tests
+    vector<Value *> tested;
+    if (ICmpInst *icmp = dyn_cast<ICmpInst>(inst)) {
+      checks.has_icmp = true;
+      tested.push_back(icmp->getOperand(0));
+      tested.push_back(icmp->getOperand(1));
+    } else if (ReturnInst *ret = dyn_cast<ReturnInst>(inst)) {
+      if (ret->getNumOperands() > 0) {
+        tested.push_back(ret->getOperand(0));
+      }
+    } else if (CallInst *call = dyn_cast<CallInst>(inst)) {
+      if (call_sites->getCallInfo(*call).model == ModelKind::ErrorTest) {
+        for (unsigned i = 0; i < call->getNumArgOperands(); ++i) {
+          tested.push_back(call->getArgOperand(i));
+        }
+      }
+    } else if (SwitchInst *swtch = dyn_cast<SwitchInst>(inst)) {
+      tested.push_back(swtch->getCondition());
+    }
+
+    if (tested.empty()) {
+      continue;
+    }
+
+    shared_ptr<ReturnPropagationPointerFact> input_fact =
+        return_propagation->getInputFactAt(inst);
+    unordered_set<CallInst *> held;
+    for (Value *v : tested) {
+      for (CallInst *call : input_fact->getHeldCalls(v)) {
+        if (held.insert(call).second) {
+          checks.sites[call].push_back(inst);
+        }
+      }
+    }
   }
 }
 
@@ -267,7 +458,8 @@ bool MissingChecks::checkIsSufficient(ICmpInst *icmp, CallInst *call) const {
   shared_ptr<ReturnPropagationPointerFact> input_fact = 
     return_propagation->getInputFactAt(icmp);
 
-  string fname = getCalleeName(*call);
+  const string &fname =
+      call_sites->getFunctionIds().getName(call_sites->getCallInfo(*call).id);
   Function *parent = icmp->getParent()->getParent();
 
   bool debug = false;
@@ -275,10 +467,10 @@ bool MissingChecks::checkIsSufficient(ICmpInst *icmp, CallInst *call) const {
     debug = true;
   }
 
-  if (function_specs.find(fname) == function_specs.end()) {
+  Constraint spec;
+  if (!findSpec(fname, spec)) {
     return false;
   }
-  Constraint spec = function_specs.at(fname);
 
   LOG_IF(INFO, debug) << "E(" << fname << ")=" << spec.interval;
   if (debug) {
@@ -323,6 +515,8 @@ bool MissingChecks::checkIsSufficient(ICmpInst *icmp, CallInst *call) const {
 void MissingChecks::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addRequired<ReturnPropagationPointer>();
   AU.addRequired<ReturnConstraintsPointer>();
+  AU.addRequired<InstructionNumbering>();
+  AU.addRequired<CallSiteIndex>();
   AU.setPreservesAll();
 }
 
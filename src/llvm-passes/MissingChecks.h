@@ -1,6 +1,7 @@
 #ifndef MISSINGCHECKS_H
 #define MISSINGCHECKS_H
 
+#include "Dataflow.hpp"
 #include "ReturnPropagationPointer.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
@@ -8,29 +9,130 @@
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
 #include "Constraint.h"
+#include <iostream>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+class CallSiteIndex;
+namespace errspec {
+class SpecSnapshot;
+}
+struct ErrorBlocks;
+class InstructionNumbering;
+class ReturnConstraintsPointer;
+
 class MissingChecks : public llvm::ModulePass {
 public:
   static char ID;
 
-  MissingChecks() : llvm::ModulePass(ID) {}
+  MissingChecks() : MissingChecks("", "", "") {}
   explicit MissingChecks(std::string specs_path, std::string error_only_path, std::string debug_function)
-      : llvm::ModulePass(ID), specs_path(specs_path), error_only_path(error_only_path), debug_function(debug_function) {}
+      : MissingChecks(specs_path, error_only_path, debug_function, 1) {}
+  MissingChecks(std::string specs_path, std::string error_only_path,
+                std::string debug_function, unsigned jobs);
+  // With the contents of the files, already read
+  MissingChecks(const std::unordered_map<std::string, Constraint> &specs,
+                const std::unordered_set<std::string> &error_only,
+                std::string debug_function, unsigned jobs = 1)
+      : llvm::ModulePass(ID), debug_function(debug_function), jobs(jobs),
+        function_specs(specs), error_only(error_only) {}
+  // With specs mapped from a snapshot, looked up in place
+  MissingChecks(std::shared_ptr<const errspec::SpecSnapshot> specs,
+                const std::unordered_set<std::string> &error_only,
+                std::string debug_function, unsigned jobs = 1)
+      : llvm::ModulePass(ID), debug_function(debug_function), jobs(jobs),
+        spec_snapshot(specs), error_only(error_only) {}
 
   bool runOnModule(llvm::Module &M) override;
   virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const;
 
+  // If set, the specs inferred by this pass are checked instead of the specs
+  // file. It must run before MissingChecks in the same pass manager.
+  ErrorBlocks *spec_source = nullptr;
+
+  // Where bugs are printed
+  std::ostream *output = &std::cout;
+
+  // A call to an error-only function shortly after a call that succeeded,
+  // printed as "location fname interval fname spec"
+  struct ErrorOnlyReport {
+    std::string location;
+
+    // The successful call, with the constraint of the error-only call's block
+    Constraint success;
+
+    // Its spec, which the constraint does not meet
+    Constraint error_spec;
+  };
+
+  // What visitCallInst found at one call site. Call sites are checked
+  // concurrently and their results are merged in module order.
+  struct CallSiteResult {
+    // Report for a call to an error-only function after a successful call
+    bool has_error_only_report = false;
+    ErrorOnlyReport error_only_report;
+
+    // Callee, if it has a spec
+    std::string fname;
+
+    // Counted as checked (or filtered)
+    bool checked = false;
+
+    // Location of an unchecked call with debug info
+    std::string unchecked_loc;
+  };
+
+  // Call sites are checked in the functions in scope. The results for the
+  // other functions are taken from cached_results, if they are there.
+  errspec::FunctionScope scope;
+  std::unordered_map<const llvm::Function *, std::vector<CallSiteResult>>
+      cached_results;
+
+  // Merged results of the module, as printed
+  const std::unordered_map<std::string, int> &getCheckedCalls() const {
+    return checked_calls;
+  }
+  const std::unordered_map<std::string, int> &getUncheckedCalls() const {
+    return unchecked_calls;
+  }
+  const std::vector<std::pair<std::string, std::string>> &
+  getUncheckedLocations() const {
+    return unchecked_locs;
+  }
+  const std::vector<ErrorOnlyReport> &getErrorOnlyReports() const {
+    return error_only_reports;
+  }
+
+  // The results of the call sites of F, which must be in scope
+  const std::vector<CallSiteResult> &getResults(const llvm::Function &F) const;
+
+  // One line per result, as stored in the analysis cache
+  static void writeResults(const std::vector<CallSiteResult> &results,
+                           std::ostream &out);
+  static bool readResults(std::istream &in,
+                          std::vector<CallSiteResult> &results);
+
+  static std::string formatReport(const ErrorOnlyReport &report);
+
+  // The calls before F in module order that the window before an error-only
+  // call in F can reach, as "distance callee" counted back from the start of
+  // F. The results of F depend on them as well as on F.
+  static std::vector<std::string> callsBefore(const llvm::Function &F);
+
 private:
-  std::string specs_path;
-  std::string error_only_path;
   std::string debug_function;
 
+  // Number of threads checking call sites
+  unsigned jobs = 1;
+
   // Function names to check
   std::unordered_map<std::string, Constraint> function_specs;
+  std::shared_ptr<const errspec::SpecSnapshot> spec_snapshot;
+
+  bool findSpec(const std::string &fname, Constraint &spec) const;
 
   // Map from functions to handled functions union of all checks
   std::unordered_map<llvm::Function*, std::unordered_map<std::string, Constraint>> handled_functions;
@@ -44,18 +146,38 @@ private:
   // Unchecked call site locations
   std::vector<std::pair<std::string, std::string>> unchecked_locs;
 
-  void readSpecsFile();
+  std::vector<ErrorOnlyReport> error_only_reports;
+
+  // The check-like instructions of a function (icmps, returns, switches and
+  // error tests like IS_ERR), by the calls whose return value they test
+  struct FunctionChecks {
+    std::unordered_map<const llvm::CallInst *, std::vector<llvm::Instruction *>>
+        sites;
+    bool has_icmp = false;
+  };
+  std::unordered_map<const llvm::Function *, FunctionChecks> function_checks;
+
+  // Results of the call sites of each function in scope
+  std::unordered_map<const llvm::Function *, std::vector<CallSiteResult>>
+      function_results;
+
+  void mergeResult(const CallSiteResult &result);
   void populateHandledFunctions(llvm::Module &M);
+  void indexChecks(llvm::Function &F, FunctionChecks &checks) const;
 
   bool checkIsSufficient(llvm::ICmpInst *icmp, llvm::CallInst *call) const;
 
-  std::unordered_map<llvm::Instruction*, uint64_t> instruction_numbers;
-  uint64_t next_inst_num = 0;
-
   ReturnPropagationPointer *return_propagation = nullptr;
-  void visitCallInst(llvm::CallInst *I);
+  ReturnConstraintsPointer *return_constraints = nullptr;
+
+  // Instructions are numbered in module order
+  InstructionNumbering *numbering = nullptr;
+
+  // Calls to each callee sorted by instruction number, and the callee, error
+  // model and flags of every call
+  CallSiteIndex *call_sites = nullptr;
 
-  void readErrorOnlyFile();
+  void visitCallInst(llvm::CallInst *I, CallSiteResult &result) const;
 
   // Error-only functions (from config file)
   std::unordered_set<std::string> error_only;
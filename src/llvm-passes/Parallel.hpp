@@ -0,0 +1,114 @@
+// Helpers for running independent pieces of an analysis on several threads.
+// With jobs <= 1 everything runs on the calling thread, in order.
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace errspec {
+
+// Calls fn(i) for every i in [0, n)
+template <class Fn> void parallelFor(unsigned jobs, size_t n, Fn fn) {
+  if (jobs <= 1 || n <= 1) {
+    for (size_t i = 0; i < n; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < n; i = next++) {
+      fn(i);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  size_t num_threads = std::min<size_t>(jobs, n);
+  for (size_t t = 1; t < num_threads; ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+// Calls fn(node) for every node of a DAG, only after fn has returned for all
+// of the nodes it depends on.
+// dependents[i]: the nodes that depend on node i
+// num_deps[i]: the number of nodes that node i depends on
+template <class Fn>
+void parallelDAG(unsigned jobs,
+                 const std::vector<std::vector<unsigned>> &dependents,
+                 std::vector<unsigned> num_deps, Fn fn) {
+  size_t n = dependents.size();
+  std::deque<unsigned> ready;
+  for (unsigned i = 0; i < n; ++i) {
+    if (num_deps[i] == 0) {
+      ready.push_back(i);
+    }
+  }
+
+  if (jobs <= 1) {
+    while (!ready.empty()) {
+      unsigned node = ready.front();
+      ready.pop_front();
+      fn(node);
+      for (unsigned d : dependents[node]) {
+        if (--num_deps[d] == 0) {
+          ready.push_back(d);
+        }
+      }
+    }
+    return;
+  }
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t remaining = n;
+
+  auto worker = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [&]() { return !ready.empty() || remaining == 0; });
+      if (ready.empty()) {
+        return;
+      }
+      unsigned node = ready.front();
+      ready.pop_front();
+
+      lock.unlock();
+      fn(node);
+      lock.lock();
+
+      for (unsigned d : dependents[node]) {
+        if (--num_deps[d] == 0) {
+          ready.push_back(d);
+        }
+      }
+      --remaining;
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < jobs; ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+} // namespace errspec
+
+#endif
@@ -0,0 +1,95 @@
+#include "Relevance.h"
+#include "CallGraphSCCs.h"
+#include "Common.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include <vector>
+
+using namespace llvm;
+using namespace std;
+
+namespace errspec {
+
+// True if F calls an error-only function or has an error code operand
+static bool seedsSpec(const Function &F,
+                      const unordered_set<string> &error_only,
+                      const ErrorCodeClassifier &error_codes) {
+  for (const BasicBlock &BB : F) {
+    for (const Instruction &I : BB) {
+      const CallInst *call = dyn_cast<CallInst>(&I);
+      if (call && error_only.count(getCalleeName(*call))) {
+        return true;
+      }
+      for (const Value *operand : I.operands()) {
+        const ConstantInt *constant = dyn_cast<ConstantInt>(operand);
+        if (constant && constant->getBitWidth() <= 64 &&
+            error_codes.contains(constant->getSExtValue())) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+unordered_set<const Function *>
+specRelevantFunctions(Module &M, const unordered_set<string> &error_only,
+                      const unordered_map<string, Constraint> &input_specs,
+                      const ErrorCodeClassifier &error_codes) {
+  unordered_set<const Function *> relevant;
+
+  // Functions that seed a spec and callers of the input specs, then their
+  // callers
+  CallGraphSCCs call_graph(M);
+  vector<const Function *> worklist;
+  for (Function &F : M) {
+    if (!F.isDeclaration() && seedsSpec(F, error_only, error_codes) &&
+        relevant.insert(&F).second) {
+      worklist.push_back(&F);
+    }
+  }
+  for (const auto &spec : input_specs) {
+    for (Function *caller : call_graph.getCallers(spec.first)) {
+      if (relevant.insert(caller).second) {
+        worklist.push_back(caller);
+      }
+    }
+  }
+  while (!worklist.empty()) {
+    const Function *F = worklist.back();
+    worklist.pop_back();
+    for (Function *caller : call_graph.getCallers(F->getName())) {
+      if (relevant.insert(caller).second) {
+        worklist.push_back(caller);
+      }
+    }
+  }
+  return relevant;
+}
+
+static bool callsSpec(const Function &F,
+                      const function<bool(const string &)> &has_spec) {
+  for (const BasicBlock &BB : F) {
+    for (const Instruction &I : BB) {
+      const CallInst *call = dyn_cast<CallInst>(&I);
+      if (call && has_spec(getCalleeName(*call))) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+unordered_set<const Function *>
+checkRelevantFunctions(Module &M,
+                       const function<bool(const string &)> &has_spec) {
+  unordered_set<const Function *> relevant;
+  for (Function &F : M) {
+    if (callsSpec(F, has_spec)) {
+      relevant.insert(&F);
+    }
+  }
+  return relevant;
+}
+
+} // namespace errspec
@@ -0,0 +1,47 @@
+// The functions of a module that can take part in a specification or a bug,
+// found from the call graph before any dataflow pass runs.
+//
+// ErrorBlocks can only give a function an error specification, or an error
+// propagation edge, if the function
+// - calls an error-only function,
+// - has an error code (see ErrorCodes.h) among its constant operands, or
+// - calls a function with an input specification or with a specification
+//   inferred in the module.
+// The last case follows the first two up the call graph to their callers.
+//
+// MissingChecks only reports calls to functions with a specification, and
+// calls to error-only functions after such a call, so it only needs the
+// functions that call a function with a specification.
+//
+// The dataflow passes leave the other functions out of their scope. Their
+// facts would never be read, so the results are the same.
+
+#ifndef RELEVANCE_H
+#define RELEVANCE_H
+
+#include "Constraint.h"
+#include "ErrorCodes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace errspec {
+
+// Defined functions that may get a specification
+std::unordered_set<const llvm::Function *>
+specRelevantFunctions(llvm::Module &M,
+                      const std::unordered_set<std::string> &error_only,
+                      const std::unordered_map<std::string, Constraint> &input_specs,
+                      const ErrorCodeClassifier &error_codes);
+
+// Defined functions that call a function for which has_spec is true
+std::unordered_set<const llvm::Function *>
+checkRelevantFunctions(llvm::Module &M,
+                       const std::function<bool(const std::string &)> &has_spec);
+
+} // namespace errspec
+
+#endif
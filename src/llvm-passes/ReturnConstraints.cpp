@@ -2,11 +2,14 @@
 #include <iostream>
 #include <string>
 
+#include "CallSiteIndex.h"
 #include "Common.h"
+#include "Dataflow.hpp"
 #include "ReturnConstraints.h"
 #include "ReturnPropagation.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/Constants.h"
+#include <glog/logging.h>
 
 using namespace llvm;
 using namespace std;
@@ -14,106 +17,91 @@ using namespace errspec;
 
 #define DEBUG false
 
+// Instructions other than calls and branches leave the constraints unchanged
+static bool isTransparent(const Instruction &I) {
+  return !isa<CallInst>(I) && !isa<BranchInst>(I);
+}
+
 bool ReturnConstraints::runOnModule(Module &M) {
-  // Initialize program points to empty ReturnConstraintsFact
-  // Creates a new fact at every point
-  std::shared_ptr<ReturnConstraintsFact> prev = nullptr;
-  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-    for (auto bi = fi->begin(), be = fi->end(); bi != be; ++bi) {
-      for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
-        Instruction *inst = &(*ii);
-        if (prev == nullptr) {
-          input_facts[inst] = std::make_shared<ReturnConstraintsFact>();
-        } else {
-          input_facts[inst] = prev;
-        }
-        auto out = std::make_shared<ReturnConstraintsFact>();
-        output_facts[inst] = out;
-        prev = out;
-      }
-      prev = nullptr;
-    }
-  }
+  return_propagation = &getAnalysis<ReturnPropagation>();
+  call_sites = &getAnalysis<CallSiteIndex>();
+  function_ids = &call_sites->getFunctionIds();
+  initFacts(getAnalysis<InstructionNumbering>(), input_facts, output_facts);
 
-  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-    runOnFunction(*fi);
-  }
+  stats = solveFunctions(M, jobs, scope,
+                         [this](Function &F) { return runOnFunction(F); });
+  LOG(INFO) << "ReturnConstraints: " << stats.visits << " block visits for "
+            << stats.blocks << " blocks";
 
   return false;
 }
 
-void ReturnConstraints::runOnFunction(Function &F) {
-  string fname = F.getName().str();
-
-  bool changed = true;
-  while (changed) {
-    changed = false;
+DataflowStats ReturnConstraints::runOnFunction(Function &F) {
+  createFacts(F, input_facts, output_facts, isTransparent);
+  DataflowStats function_stats = solveDataflow<Direction::Forward>(
+      F, input_facts, output_facts,
+      [this](BasicBlock &BB) { return visitBlock(BB); });
 
+  if (DEBUG) {
     for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
-      BasicBlock *BB = &*bi;
-      Instruction *succ_begin = &*(BB->begin());
-      auto succ_fact = input_facts.at(succ_begin);
-
-      // Go over predecessor blocks and apply join
-      for (auto pi = pred_begin(BB), pe = pred_end(BB); pi != pe; ++pi) {
-        Instruction *pred_term = (*pi)->getTerminator();
-        auto pred_fact = output_facts.at(pred_term);
-        succ_fact->join(*pred_fact);
-      }
-
-      changed = visitBlock(*BB) || changed;
-    }
-
-    if (DEBUG) {
-      for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
-        for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
-          input_facts.at(&*ii)->dump();
-          ii->dump();
-          output_facts.at(&*ii)->dump();
-        }
+      for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
+        input_facts.at(&*ii)->dump();
+        ii->dump();
+        output_facts.at(&*ii)->dump();
       }
     }
   }
-  return;
+
+  pruneFacts(F, input_facts, output_facts, retention);
+  return function_stats;
 }
 
+// Returns true if the fact at the exit of the block changed, or if the
+// terminator narrowed the entry fact of a successor
 bool ReturnConstraints::visitBlock(BasicBlock &BB) {
-  bool changed = false;
-  for (auto ii = BB.begin(), ie = BB.end(); ii != ie; ++ii) {
+  shared_ptr<ReturnConstraintsFact> bb_out_fact = output_facts.at(&BB.back());
+  ReturnConstraintsFact prev_fact = *bb_out_fact;
+  bool successor_changed = false;
+
+  unsigned slot = input_facts.getNumbering().getFirst(&BB);
+  for (auto ii = BB.begin(), ie = BB.end(); ii != ie; ++ii, ++slot) {
     Instruction &I = *ii;
 
-    shared_ptr<ReturnConstraintsFact> input_fact = input_facts.at(&I);
-    shared_ptr<ReturnConstraintsFact> output_fact = output_facts.at(&I);
+    shared_ptr<ReturnConstraintsFact> input_fact = input_facts[slot];
+    shared_ptr<ReturnConstraintsFact> output_fact = output_facts[slot];
 
-    ReturnConstraintsFact prev_fact = *output_fact;
-    if (CallInst *inst = dyn_cast<CallInst>(&I)) {
-      visitCallInst(*inst, input_fact, output_fact);
-    } else if (BranchInst *inst = dyn_cast<BranchInst>(&I)) {
-      visitBranchInst(*inst, input_fact, output_fact);
-    } else if (PHINode *inst = dyn_cast<PHINode>(&I)) {
-      visitPHINode(*inst, input_fact, output_fact);
-    } else {
-      // Default is to just copy facts from previous instruction unchanged.
-      output_fact->value = input_fact->value;
+    // Transparent instructions share one fact, there is nothing to copy
+    if (input_fact == output_fact) {
+      continue;
     }
-    changed = changed || (*(output_fact) != prev_fact);
+
+    successor_changed =
+        visitInstruction(I, input_fact, output_fact) || successor_changed;
   }
 
-  return changed;
+  return successor_changed || *bb_out_fact != prev_fact;
+}
+
+// Returns true if I is a branch that narrowed the entry fact of a successor
+bool ReturnConstraints::visitInstruction(
+    Instruction &I, shared_ptr<const ReturnConstraintsFact> in,
+    shared_ptr<ReturnConstraintsFact> out) {
+  if (CallInst *inst = dyn_cast<CallInst>(&I)) {
+    visitCallInst(*inst, in, out);
+  } else if (BranchInst *inst = dyn_cast<BranchInst>(&I)) {
+    return visitBranchInst(*inst, in, out);
+  } else {
+    // Default is to just copy facts from previous instruction unchanged.
+    out->value = in->value;
+  }
+  return false;
 }
 
 void ReturnConstraints::visitCallInst(
     CallInst &I, shared_ptr<const ReturnConstraintsFact> in,
     shared_ptr<ReturnConstraintsFact> out) {
   out->value = in->value;
-  unordered_set<Value *> gen_value({&I});
-
-  string callee_name = getCalleeName(I);
-
-  Constraint c(callee_name);
-  c.interval = Interval::TOP;
-
-  out->value[callee_name] = c;
+  out->value.set(call_sites->getCallInfo(I).id, Interval::TOP);
 }
 
 pair<Interval, Interval> ReturnConstraints::abstractICmp(ICmpInst &I) {
@@ -165,13 +153,24 @@ pair<Interval, Interval> ReturnConstraints::abstractICmp(ICmpInst &I) {
   return make_pair(true_interval, false_interval);
 }
 
-void ReturnConstraints::visitBranchInst(
+bool ReturnConstraints::readsPropagationFactAt(const Instruction &I) {
+  for (const User *user : I.users()) {
+    const ICmpInst *icmp = dyn_cast<ICmpInst>(user);
+    if (icmp && icmp->getOperand(0) == &I) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if the entry fact of either successor was narrowed
+bool ReturnConstraints::visitBranchInst(
     BranchInst &I, shared_ptr<const ReturnConstraintsFact> in,
     shared_ptr<ReturnConstraintsFact> out) {
   out->value = in->value;
 
   if (I.isUnconditional()) {
-    return;
+    return false;
   }
   Value *condition = I.getOperand(0);
   assert(condition);
@@ -179,11 +178,9 @@ void ReturnConstraints::visitBranchInst(
   // TODO: If it is a call to IS_ERR we should handle it too.
   ICmpInst *icmp = dyn_cast<ICmpInst>(condition);
   if (!icmp) {
-    return;
+    return false;
   }
 
-  ReturnPropagation *return_propagation = &getAnalysis<ReturnPropagation>();
-
   BasicBlock *true_bb = dyn_cast<BasicBlock>(I.getOperand(2));
   assert(true_bb);
   BasicBlock *false_bb = dyn_cast<BasicBlock>(I.getOperand(1));
@@ -194,12 +191,11 @@ void ReturnConstraints::visitBranchInst(
   // Get the set of function whose values reach icmp operand from
   // return-propagation
   Value *icmp_value = icmp->getOperand(0);
-  if (return_propagation->output_facts.find(icmp_value) ==
-      return_propagation->output_facts.end()) {
-    return;
+  if (!return_propagation->output_facts.contains(icmp_value)) {
+    return false;
   }
 
-  auto fact = return_propagation->output_facts.at(icmp_value);
+  auto fact = return_propagation->getOutFact(icmp_value);
 
   // The first element of this pair is the llvm value being tested
   // The second element is the set of functions which the key value may hold.
@@ -210,6 +206,7 @@ void ReturnConstraints::visitBranchInst(
     }
   }
 
+  bool changed = false;
   for (Value *v : test_ret_values) {
     ReturnConstraintsFact true_fact;
     ReturnConstraintsFact false_fact;
@@ -217,53 +214,53 @@ void ReturnConstraints::visitBranchInst(
     if (!isa<CallInst>(v))
       continue;
 
-    // Get the function name associated with v
+    // Get the function id associated with v
     CallInst *call = dyn_cast<CallInst>(v);
-    string fname = getCalleeName(*call);
+    FunctionId fid = call_sites->getCallInfo(*call).id;
 
     // kill constraints for functions being tested
     // prevents predecessor join from setting everything to top
     // splits constraint interval at branches
-    Constraint kill_constraint(fname);
-    kill_constraint.interval = Interval::BOT;
-    out->value[fname] = kill_constraint;
+    out->value.set(fid, Interval::BOT);
 
-    Constraint true_c(fname);
-    true_c.interval = true_abstract_value;
-    Constraint false_c(fname);
-    false_c.interval = false_abstract_value;
-
-    true_fact.value[fname] = true_c;
-    false_fact.value[fname] = false_c;
+    true_fact.value.set(fid, true_abstract_value);
+    false_fact.value.set(fid, false_abstract_value);
 
     Instruction *true_first = GetFirstInstructionOfBB(true_bb);
     auto existing_true_fact = input_facts.at(true_first);
-    existing_true_fact->meet(true_fact);
+    changed = existing_true_fact->meet(true_fact) || changed;
 
     Instruction *false_first = GetFirstInstructionOfBB(false_bb);
     auto existing_false_fact = input_facts.at(false_first);
-    existing_false_fact->meet(false_fact);
+    changed = existing_false_fact->meet(false_fact) || changed;
   }
-}
 
-// If the PHI result can be returned, then add incoming values
-// to the exit of each incoming basic block
-void ReturnConstraints::visitPHINode(PHINode &I,
-                                     shared_ptr<const ReturnConstraintsFact> in,
-                                     shared_ptr<ReturnConstraintsFact> out) {
+  return changed;
+}
 
-  out->value = in->value;
+ReturnConstraintsFact ReturnConstraints::getInFact(Value *v) {
+  return *getFact(*cast<Instruction>(v), true);
 }
 
-ReturnConstraintsFact ReturnConstraints::getInFact(Value *v) const {
-  return *(input_facts.at(v));
+ReturnConstraintsFact ReturnConstraints::getOutFact(Value *v) {
+  return *getFact(*cast<Instruction>(v), false);
 }
 
-ReturnConstraintsFact ReturnConstraints::getOutFact(Value *v) const {
-  return *(output_facts.at(v));
+// Replays I's block if the fact was not kept. Terminators are always kept, so
+// replays never write into the facts of successors.
+shared_ptr<ReturnConstraintsFact>
+ReturnConstraints::getFact(Instruction &I, bool input) {
+  return replayFact<Direction::Forward>(
+      I, input, input_facts, output_facts,
+      [this](Instruction &J, shared_ptr<const ReturnConstraintsFact> in,
+             shared_ptr<ReturnConstraintsFact> out) {
+        visitInstruction(J, in, out);
+      });
 }
 
 void ReturnConstraints::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<CallSiteIndex>();
+  AU.addRequired<InstructionNumbering>();
   AU.addRequired<ReturnPropagation>();
   AU.setPreservesAll();
 }
@@ -2,6 +2,8 @@
 #define RETURNCONSTRAINTS_H
 
 #include "Constraint.h"
+#include "ConstraintMap.h"
+#include "Dataflow.hpp"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
@@ -12,7 +14,8 @@
 
 class ReturnConstraintsFact {
 public:
-  std::unordered_map<std::string, Constraint> value;
+  // Constrained callees, by id in CallSiteIndex's FunctionIds
+  errspec::ConstraintMap value;
 
   ReturnConstraintsFact() {}
 
@@ -22,9 +25,8 @@ public:
   }
 
   void dump() {
-    for (auto kv : value) {
-      std::string fn = kv.first;
-      std::cerr << fn << ": " << kv.second << " ";
+    for (auto &entry : value) {
+      std::cerr << entry.first << ": " << entry.second << " ";
     }
     std::cerr << std::endl;
   }
@@ -38,66 +40,86 @@ public:
 
   void join(const ReturnConstraintsFact &other) {
     // For each function key, join the constraints
-    for (auto kv : other.value) {
-      std::string fn = kv.first;
-      if (value.find(fn) == value.end()) {
-        value[fn] = kv.second;
-      }
-      value[fn] = value[fn].join(kv.second);
-    }
+    value.join(other.value);
   }
 
-  void meet(const ReturnConstraintsFact &other) {
+  // Returns true if this fact changed
+  bool meet(const ReturnConstraintsFact &other) {
     // For each function key, meet the constraints
-    for (auto kv : other.value) {
-      std::string fn = kv.first;
-      if (value.find(fn) == value.end()) {
-        value[fn] = kv.second;
-      }
-      value[fn] = value[fn].meet(kv.second);
-    }
+    return value.meet(other.value);
   }
 };
 
+class CallSiteIndex;
+struct ReturnPropagation;
+
 class ReturnConstraints : public llvm::ModulePass {
 public:
   static char ID;
 
   ReturnConstraints() : llvm::ModulePass(ID) {}
+  explicit ReturnConstraints(unsigned jobs) : llvm::ModulePass(ID), jobs(jobs) {}
 
   // Entry point
   bool runOnModule(llvm::Module &M);
 
   // Called for each function
-  void runOnFunction(llvm::Function &F);
+  errspec::DataflowStats runOnFunction(llvm::Function &F);
+
+  // Facts at points that were not kept are recomputed
+  ReturnConstraintsFact getInFact(llvm::Value *);
+  ReturnConstraintsFact getOutFact(llvm::Value *);
+
+  // Program points whose facts are kept once a function is solved
+  errspec::FactRetention retention;
+
+  // Functions that are solved
+  errspec::FunctionScope scope;
 
-  ReturnConstraintsFact getInFact(llvm::Value *) const;
-  ReturnConstraintsFact getOutFact(llvm::Value *) const;
+  // The points at which this pass reads ReturnPropagation facts: the
+  // instructions compared by an icmp
+  static bool readsPropagationFactAt(const llvm::Instruction &I);
+
+  // Names of the callees that facts refer to by id
+  const errspec::FunctionIds &getFunctionIds() const { return *function_ids; }
+
+  // Worklist iteration counts over the module
+  errspec::DataflowStats stats;
+
+  // Number of threads solving functions
+  unsigned jobs = 1;
 
 private:
+  // Fetched once in runOnModule so that worker threads never go through
+  // the pass manager
+  ReturnPropagation *return_propagation = nullptr;
+
+  // Resolves the callee of every call, once for all passes
+  const CallSiteIndex *call_sites = nullptr;
+  const errspec::FunctionIds *function_ids = nullptr;
+
   // Called for each basic block
   bool visitBlock(llvm::BasicBlock &BB);
+  bool visitInstruction(llvm::Instruction &I,
+                        std::shared_ptr<const ReturnConstraintsFact> input,
+                        std::shared_ptr<ReturnConstraintsFact> out);
+  std::shared_ptr<ReturnConstraintsFact> getFact(llvm::Instruction &I, bool input);
 
   // Transfer functions
   void visitCallInst(llvm::CallInst &I,
                      std::shared_ptr<const ReturnConstraintsFact> input,
                      std::shared_ptr<ReturnConstraintsFact> out);
-  void visitBranchInst(llvm::BranchInst &I,
+  bool visitBranchInst(llvm::BranchInst &I,
                        std::shared_ptr<const ReturnConstraintsFact> input,
                        std::shared_ptr<ReturnConstraintsFact> out);
-  void visitPHINode(llvm::PHINode &I,
-                    std::shared_ptr<const ReturnConstraintsFact> input,
-                    std::shared_ptr<ReturnConstraintsFact> out);
 
   virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const;
 
-  // A map from values (instructions) to dataflow facts
-  std::unordered_map<llvm::Value *, std::shared_ptr<ReturnConstraintsFact>>
-      input_facts;
+  // Dataflow facts by instruction number
+  errspec::FactTable<ReturnConstraintsFact> input_facts;
 
-  // A map from values (instructions) to dataflow facts
-  std::unordered_map<llvm::Value *, std::shared_ptr<ReturnConstraintsFact>>
-      output_facts;
+  // Dataflow facts by instruction number
+  errspec::FactTable<ReturnConstraintsFact> output_facts;
 
   std::pair<Interval, Interval> abstractICmp(llvm::ICmpInst &I);
 };
@@ -2,6 +2,7 @@
 #include <memory>
 #include <string>
 
+#include "Dataflow.hpp"
 #include "ReturnPropagation.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/AliasSetTracker.h"
@@ -12,120 +13,105 @@
 #include "llvm/IR/InstIterator.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
+#include <glog/logging.h>
 
 using namespace llvm;
 using namespace std;
+using namespace errspec;
 
 #define DEBUG false
 
+// Instructions that visitBlock copies the fact across unchanged
+static bool isTransparent(const Instruction &I) {
+  return !isa<CallInst>(I) && !isa<LoadInst>(I) && !isa<StoreInst>(I)
+         && !isa<BitCastInst>(I) && !isa<PtrToIntInst>(I)
+         && !isa<BinaryOperator>(I) && !isa<PHINode>(I);
+}
+
 bool ReturnPropagation::runOnModule(Module &M) {
   if (finished)
     return false;
 
-  std::shared_ptr<ReturnPropagationFact> prev = nullptr;
-  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-    for (auto bi = fi->begin(), be = fi->end(); bi != be; ++bi) {
-      for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
-        // Initialize every instruction to empty
-        // Creates a new fact at every point
-        Instruction *inst = &(*ii);
-        if (prev == nullptr) {
-          input_facts[inst] = std::make_shared<ReturnPropagationFact>();
-        } else {
-          input_facts[inst] = prev;
-        }
-        auto out = std::make_shared<ReturnPropagationFact>();
-        output_facts[inst] = out;
-        prev = out;
-
-      }
-      prev = nullptr;
-    }
-  }
+  initFacts(getAnalysis<InstructionNumbering>(), input_facts, output_facts);
 
-  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-    runOnFunction(*fi);
-  }
-
-  if (DEBUG) {
-    for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-      for (auto bi = fi->begin(), be = fi->end(); bi != be; ++bi) {
-        for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
-          cerr << "=====\n";
-          input_facts.at(&*ii)->dump();
-          cerr << "---\n";
-          ii->dump();
-          cerr << "---\n";
-          output_facts.at(&*ii)->dump();
-          cerr << "=====\n\n";
-        }
-      }
-    }
-  }
+  stats = solveFunctions(M, jobs, scope,
+                         [this](Function &F) { return runOnFunction(F); });
+  LOG(INFO) << "ReturnPropagation: " << stats.visits << " block visits for "
+            << stats.blocks << " blocks";
 
   finished = true;
 
   return false;
 }
 
-bool ReturnPropagation::runOnFunction(Function &F) {
-  string fname = F.getName().str();
-
-  bool changed = true;
-  while (changed) {
-    changed = false;
+DataflowStats ReturnPropagation::runOnFunction(Function &F) {
+  createFacts(F, input_facts, output_facts, isTransparent);
+  DataflowStats function_stats = solveDataflow<Direction::Forward>(
+      F, input_facts, output_facts,
+      [this](BasicBlock &BB) { return visitBlock(BB); });
 
+  if (DEBUG) {
     for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
-      BasicBlock *BB = &*bi;
-      Instruction *succ_begin = &*(BB->begin());
-      auto succ_fact = input_facts.at(succ_begin);
-
-      // Go over predecessor blocks and apply join
-      for (auto pi = pred_begin(BB), pe = pred_end(BB); pi != pe; ++pi) {
-        Instruction *pred_term = (*pi)->getTerminator();
-        auto pred_fact = output_facts.at(pred_term);
-        succ_fact->join(*pred_fact);
+      for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
+        cerr << "=====\n";
+        input_facts.at(&*ii)->dump();
+        cerr << "---\n";
+        ii->dump();
+        cerr << "---\n";
+        output_facts.at(&*ii)->dump();
+        cerr << "=====\n\n";
       }
-
-      changed = visitBlock(*BB) || changed;
     }
   }
 
-  return false;
+  pruneFacts(F, input_facts, output_facts, retention);
+  return function_stats;
 }
 
+// Returns true if the fact at the exit of the block changed
 bool ReturnPropagation::visitBlock(BasicBlock &BB) {
-  bool changed = false;
-  for (auto ii = BB.begin(), ie = BB.end(); ii != ie; ++ii) {
+  shared_ptr<ReturnPropagationFact> bb_out_fact = output_facts.at(&BB.back());
+  ReturnPropagationFact prev_fact = *bb_out_fact;
+
+  unsigned slot = input_facts.getNumbering().getFirst(&BB);
+  for (auto ii = BB.begin(), ie = BB.end(); ii != ie; ++ii, ++slot) {
     Instruction &I = *ii;
 
-    shared_ptr<ReturnPropagationFact> input_fact = input_facts.at(&I);
-    shared_ptr<ReturnPropagationFact> output_fact = output_facts.at(&I);
-
-    bool changed = false;
-    if (CallInst *inst = dyn_cast<CallInst>(&I)) {
-      visitCallInst(*inst, input_fact, output_fact);
-    } else if (LoadInst *inst = dyn_cast<LoadInst>(&I)) {
-      visitLoadInst(*inst, input_fact, output_fact);
-    } else if (StoreInst *inst = dyn_cast<StoreInst>(&I)) {
-      visitStoreInst(*inst, input_fact, output_fact);
-    } else if (BitCastInst *inst = dyn_cast<BitCastInst>(&I)) {
-      visitBitCastInst(*inst, input_fact, output_fact);
-    } else if (PtrToIntInst *inst = dyn_cast<PtrToIntInst>(&I)) {
-      visitPtrToIntInst(*inst, input_fact, output_fact);
-    } else if (BinaryOperator *inst = dyn_cast<BinaryOperator>(&I)) {
-      visitBinaryOperator(*inst, input_fact, output_fact);
-    } else if (PHINode *inst = dyn_cast<PHINode>(&I)) {
-      visitPHINode(*inst, input_fact, output_fact);
-    } else {
-      // Default is to just copy facts from previous instruction unchanged.
-      output_fact->value = input_fact->value;
+    shared_ptr<ReturnPropagationFact> input_fact = input_facts[slot];
+    shared_ptr<ReturnPropagationFact> output_fact = output_facts[slot];
+
+    // Transparent instructions share one fact, there is nothing to copy
+    if (input_fact == output_fact) {
+      continue;
     }
 
-    changed = (*input_fact == *output_fact);
+    visitInstruction(I, input_fact, output_fact);
   }
 
-  return changed;
+  return *bb_out_fact != prev_fact;
+}
+
+void ReturnPropagation::visitInstruction(
+    Instruction &I, shared_ptr<const ReturnPropagationFact> in,
+    shared_ptr<ReturnPropagationFact> out) {
+  if (CallInst *inst = dyn_cast<CallInst>(&I)) {
+    visitCallInst(*inst, in, out);
+  } else if (LoadInst *inst = dyn_cast<LoadInst>(&I)) {
+    visitLoadInst(*inst, in, out);
+  } else if (StoreInst *inst = dyn_cast<StoreInst>(&I)) {
+    visitStoreInst(*inst, in, out);
+  } else if (BitCastInst *inst = dyn_cast<BitCastInst>(&I)) {
+    visitBitCastInst(*inst, in, out);
+  } else if (PtrToIntInst *inst = dyn_cast<PtrToIntInst>(&I)) {
+    visitPtrToIntInst(*inst, in, out);
+  } else if (BinaryOperator *inst = dyn_cast<BinaryOperator>(&I)) {
+    visitBinaryOperator(*inst, in, out);
+  } else if (PHINode *inst = dyn_cast<PHINode>(&I)) {
+    visitPHINode(*inst, in, out);
+  } else {
+    // Default is to just copy facts from previous instruction unchanged.
+    out->value = in->value;
+  }
 }
 
 void ReturnPropagation::visitCallInst(
@@ -228,7 +214,18 @@ void ReturnPropagation::visitPHINode(llvm::PHINode &I,
   }
 }
 
+// Replays I's block if the fact after I was not kept
+shared_ptr<ReturnPropagationFact> ReturnPropagation::getOutFact(Value *v) {
+  return replayFact<Direction::Forward>(
+      *cast<Instruction>(v), false, input_facts, output_facts,
+      [this](Instruction &J, shared_ptr<const ReturnPropagationFact> in,
+             shared_ptr<ReturnPropagationFact> out) {
+        visitInstruction(J, in, out);
+      });
+}
+
 void ReturnPropagation::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<InstructionNumbering>();
   AU.setPreservesAll();
 }
 
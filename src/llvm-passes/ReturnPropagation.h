@@ -1,6 +1,7 @@
 #ifndef RETURNPROPAGATION_H
 #define RETURNPROPAGATION_H
 
+#include "Dataflow.hpp"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
@@ -54,18 +55,36 @@ struct ReturnPropagation : public llvm::ModulePass {
   static char ID;
 
   ReturnPropagation() : llvm::ModulePass(ID) {}
+  explicit ReturnPropagation(unsigned jobs)
+      : llvm::ModulePass(ID), jobs(jobs) {}
 
   // Dataflow facts at the program point immediately following instruction
-  std::unordered_map<llvm::Value *, std::shared_ptr<ReturnPropagationFact>>
-      input_facts;
-  std::unordered_map<llvm::Value *, std::shared_ptr<ReturnPropagationFact>>
-      output_facts;
+  errspec::FactTable<ReturnPropagationFact> input_facts;
+  errspec::FactTable<ReturnPropagationFact> output_facts;
+
+  // Program points whose facts are kept once a function is solved
+  errspec::FactRetention retention;
+
+  // Functions that are solved
+  errspec::FunctionScope scope;
+
+  // The fact after instruction v, recomputed if it was not kept
+  std::shared_ptr<ReturnPropagationFact> getOutFact(llvm::Value *v);
 
   bool finished = false;
 
+  // Number of threads solving functions
+  unsigned jobs = 1;
+
+  // Worklist iteration counts over the module
+  errspec::DataflowStats stats;
+
   bool runOnModule(llvm::Module &M);
-  bool runOnFunction(llvm::Function &F);
+  errspec::DataflowStats runOnFunction(llvm::Function &F);
   bool visitBlock(llvm::BasicBlock &BB);
+  void visitInstruction(llvm::Instruction &I,
+                        std::shared_ptr<const ReturnPropagationFact> input,
+                        std::shared_ptr<ReturnPropagationFact> out);
 
   void visitCallInst(llvm::CallInst &I,
                      std::shared_ptr<const ReturnPropagationFact> input,
@@ -2,6 +2,7 @@
 #include <memory>
 #include <string>
 
+#include "Dataflow.hpp"
 #include "ReturnPropagationPointer.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/AliasSetTracker.h"
@@ -13,43 +14,39 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
+#include <glog/logging.h>
 
 using namespace llvm;
 using namespace std;
+using namespace errspec;
 
 #define DEBUG false
 
+// Instructions that visitBlock copies the fact across unchanged
+static bool isTransparent(const Instruction &I) {
+  return !isa<CallInst>(I) && !isa<LoadInst>(I) && !isa<StoreInst>(I)
+         && !isa<BitCastInst>(I) && !isa<PtrToIntInst>(I)
+         && !isa<BinaryOperator>(I) && !isa<GetElementPtrInst>(I)
+         && !isa<AllocaInst>(I) && !isa<PHINode>(I);
+}
+
 bool ReturnPropagationPointer::runOnModule(Module &M) {
   if (finished)
     return false;
 
-  std::shared_ptr<ReturnPropagationPointerFact> prev = nullptr;
+  initFacts(getAnalysis<InstructionNumbering>(), input_facts, output_facts);
   for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-    for (auto bi = fi->begin(), be = fi->end(); bi != be; ++bi) {
-      for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
-        // Initialize every instruction to empty
-        // Creates a new fact at every point
-        Instruction *inst = &(*ii);
-        if (prev == nullptr) {
-          input_facts[inst] = std::make_shared<ReturnPropagationPointerFact>();
-        } else {
-          input_facts[inst] = prev;
-        }
-        auto out = std::make_shared<ReturnPropagationPointerFact>();
-        output_facts[inst] = out;
-        prev = out;
-
-      }
-      prev = nullptr;
-    }
+    next_idx[&*fi] = 0;
   }
 
-  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-    runOnFunction(*fi);
-  }
+  stats = solveFunctions(M, jobs, scope,
+                         [this](Function &F) { return runOnFunction(F); });
+  LOG(INFO) << "ReturnPropagationPointer: " << stats.visits
+            << " block visits for " << stats.blocks << " blocks";
 
+  // Functions outside the scope have no facts
   for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-    if (fi->getName() == debug_function) {
+    if (fi->getName() == debug_function && scope.contains(*fi)) {
       for (auto bi = fi->begin(), be = fi->end(); bi != be; ++bi) {
         for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
           cerr << "=====\n";
@@ -69,30 +66,21 @@ bool ReturnPropagationPointer::runOnModule(Module &M) {
   return false;
 }
 
-bool ReturnPropagationPointer::runOnFunction(Function &F) {
-  string fname = F.getName().str();
-
-  bool changed = true;
-  while (changed) {
-    changed = false;
-
-    for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
-      BasicBlock *BB = &*bi;
-      Instruction *succ_begin = &*(BB->begin());
-      auto succ_fact = input_facts.at(succ_begin);
-
-      // Go over predecessor blocks and apply join
-      for (auto pi = pred_begin(BB), pe = pred_end(BB); pi != pe; ++pi) {
-        Instruction *pred_term = (*pi)->getTerminator();
-        auto pred_fact = output_facts.at(pred_term);
-        succ_fact->join(*pred_fact);
-      }
-
-      changed = visitBlock(*BB) || changed;
-    }
-  }
-
-  return false;
+DataflowStats ReturnPropagationPointer::runOnFunction(Function &F) {
+  // Every fact is kept: replaying a block would hand out new MemIndexes
+  createFacts(F, input_facts, output_facts, isTransparent);
+
+  // The memory model hands out a fresh MemIndex every time unknown memory is
+  // touched, so facts can grow without bound around loops. Each block is
+  // visited exactly once, in layout order: the facts a block sees from its
+  // predecessors and the MemIndexes it gets depend on that order.
+  return solveDataflow<Direction::Forward>(
+      F, input_facts, output_facts,
+      [this](BasicBlock &BB) {
+        visitBlock(BB);
+        return false;
+      },
+      BlockOrder::Layout);
 }
 
 
@@ -103,7 +91,7 @@ unordered_set<MemVal> ReturnPropagationPointer::calculateGEP(ReturnPropagationPo
   unordered_set<MemVal> ret;
 
   if (I.getNumOperands() < 3) {
-    ret.insert(MemVal(next_idx++));
+    ret.insert(freshMemIndex(I));
     return ret;
   }
 
@@ -115,13 +103,13 @@ unordered_set<MemVal> ReturnPropagationPointer::calculateGEP(ReturnPropagationPo
 
   // We only support constant indexes
   if (!idx1_int || !idx2_int) {
-    ret.insert(MemVal(next_idx++));
+    ret.insert(freshMemIndex(I));
     return ret;
   }
 
   // Lookup the base operand. If we have a memory value for it, then
   // then use that. Otherwise create a new val.
-  unordered_set<MemVal> base_mv = findOrCreateMemVal(rpf, MemVal(base));
+  unordered_set<MemVal> base_mv = findOrCreateMemVal(rpf, MemVal(base), I);
   for (auto &mv : base_mv) {
     if (mv.isRef()) {
       MemVal gep_base_idx(mv.base_idx);
@@ -138,15 +126,19 @@ unordered_set<MemVal> ReturnPropagationPointer::calculateGEP(ReturnPropagationPo
   return ret;
 }
 
-bool ReturnPropagationPointer::visitBlock(BasicBlock &BB) {
-  bool changed = false;
-  for (auto ii = BB.begin(), ie = BB.end(); ii != ie; ++ii) {
+void ReturnPropagationPointer::visitBlock(BasicBlock &BB) {
+  unsigned slot = input_facts.getNumbering().getFirst(&BB);
+  for (auto ii = BB.begin(), ie = BB.end(); ii != ie; ++ii, ++slot) {
     Instruction &I = *ii;
 
-    shared_ptr<ReturnPropagationPointerFact> input_fact = input_facts.at(&I);
-    shared_ptr<ReturnPropagationPointerFact> output_fact = output_facts.at(&I);
+    shared_ptr<ReturnPropagationPointerFact> input_fact = input_facts[slot];
+    shared_ptr<ReturnPropagationPointerFact> output_fact = output_facts[slot];
+
+    // Transparent instructions share one fact, there is nothing to copy
+    if (input_fact == output_fact) {
+      continue;
+    }
 
-    bool changed = false;
     if (CallInst *inst = dyn_cast<CallInst>(&I)) {
       visitCallInst(*inst, input_fact, output_fact);
     } else if (LoadInst *inst = dyn_cast<LoadInst>(&I)) {
@@ -169,11 +161,7 @@ bool ReturnPropagationPointer::visitBlock(BasicBlock &BB) {
       // Default is to just copy facts from previous instruction unchanged.
       output_fact->value = input_fact->value;
     }
-
-    changed = (*input_fact == *output_fact);
   }
-
-  return changed;
 }
 
 // The value of the instruction is bound to the return value of
@@ -205,28 +193,33 @@ void ReturnPropagationPointer::visitLoadInst(
   Value *load_from = I.getOperand(0);
 
   // MemVals to load from
-  unordered_set<MemVal> &load_from_vals = findOrCreateMemVal(*out, MemVal(load_from));
+  unordered_set<MemVal> &load_from_vals = findOrCreateMemVal(*out, MemVal(load_from), I);
 
   // Dereference and copy each possible entry
   unordered_set<MemVal> &load_to_val = findOrCreateMemValEmpty(*out, MemVal(&I));
 
   for (const MemVal &to_deref: load_from_vals) {
-    unordered_set<MemVal> &to_deref_vals = findOrCreateMemVal(*out, to_deref);
+    unordered_set<MemVal> &to_deref_vals = findOrCreateMemVal(*out, to_deref, I);
     for (const MemVal &deref_val : to_deref_vals) {
       load_to_val.insert(deref_val);
     }
   }
 }
 
+// A MemIndex not yet used in the function containing I
+MemVal ReturnPropagationPointer::freshMemIndex(const Instruction &I) {
+  return MemVal(next_idx.at(I.getParent()->getParent())++);
+}
+
 // When we reference memory for the first time, initialize it with
 // a MemVal that points to somewhere disjoint from other memory
 unordered_set<MemVal>&
 ReturnPropagationPointer::findOrCreateMemVal(ReturnPropagationPointerFact &rpf, const
-MemVal &v) {
+MemVal &v, const Instruction &I) {
 
   if (rpf.value.find(v) == rpf.value.end()) {
     rpf.value[v] = unordered_set<MemVal>();
-    rpf.value.at(v).insert(MemVal(next_idx++));
+    rpf.value.at(v).insert(freshMemIndex(I));
   } 
   return rpf.value.at(v);
 }
@@ -267,7 +260,7 @@ void ReturnPropagationPointer::visitStoreInst(
   Value *sender = I.getOperand(0);
   Value *receiver = I.getOperand(1);
 
-  unordered_set<MemVal> &receiver_vals = findOrCreateMemVal(*out, MemVal(receiver));
+  unordered_set<MemVal> &receiver_vals = findOrCreateMemVal(*out, MemVal(receiver), I);
 
   // v is all of the possible values that the receiver could point to
   for (const auto &v : receiver_vals) {
@@ -347,7 +340,7 @@ void ReturnPropagationPointer::visitAllocaInst(
     shared_ptr<ReturnPropagationPointerFact> out) {
 
   out->value = in->value;
-  findOrCreateMemVal(*out, MemVal(&I));
+  findOrCreateMemVal(*out, MemVal(&I), I);
 }
 
 void ReturnPropagationPointer::visitPHINode(llvm::PHINode &I,
@@ -407,7 +400,24 @@ std::unordered_set<Value*> ReturnPropagationPointerFact::getHeldValues(Value *va
   return ret;
 }
 
+std::vector<CallInst*> ReturnPropagationPointerFact::getHeldCalls(Value *var) const {
+  std::vector<CallInst*> ret;
+
+  auto it = value.find(MemVal(var));
+  if (it == value.end()) return ret;
+
+  for (const MemVal &mv : it->second) {
+    CallInst *call = dyn_cast_or_null<CallInst>(mv.base_value);
+    if (call && mv == MemVal(call)) {
+      ret.push_back(call);
+    }
+  }
+
+  return ret;
+}
+
 void ReturnPropagationPointer::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<InstructionNumbering>();
   AU.setPreservesAll();
 }
 
@@ -1,6 +1,7 @@
 #ifndef RETURNPROPAGATIONPOINTER_H
 #define RETURNPROPAGATIONPOINTER_H
 
+#include "Dataflow.hpp"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
@@ -9,6 +10,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 #include <iostream>
 #include <boost/functional/hash.hpp>
 
@@ -118,6 +120,9 @@ class ReturnPropagationPointerFact {
   // Get the LLVM values that this fact may hold
   std::unordered_set<llvm::Value*> getHeldValues(llvm::Value *var) const;
 
+  // The calls c for which valueMayHold(var, c) is true
+  std::vector<llvm::CallInst*> getHeldCalls(llvm::Value *var) const;
+
  private:
     // The memory model
     std::unordered_map<MemVal, std::unordered_set<MemVal>> value;
@@ -129,34 +134,47 @@ public:
 
   ReturnPropagationPointer() : llvm::ModulePass(ID) {}
   ReturnPropagationPointer(std::string debug_function) : llvm::ModulePass(ID), debug_function(debug_function) {}
+  ReturnPropagationPointer(std::string debug_function, unsigned jobs)
+      : llvm::ModulePass(ID), debug_function(debug_function), jobs(jobs) {}
 
   bool runOnModule(llvm::Module &M);
-  bool runOnFunction(llvm::Function &F);
+  errspec::DataflowStats runOnFunction(llvm::Function &F);
   virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const;
 
   std::string debug_function;
+
+  // Number of threads solving functions
+  unsigned jobs = 1;
+
+  // Functions that are solved
+  errspec::FunctionScope scope;
+
+  // Worklist iteration counts over the module
+  errspec::DataflowStats stats;
+
   std::shared_ptr<ReturnPropagationPointerFact> getInputFactAt(llvm::Value *v) const;
   std::shared_ptr<ReturnPropagationPointerFact> getOutputFactAt(llvm::Value *v) const;
 
 private:
   // Dataflow facts at the program point immediately following instruction
-  std::unordered_map<llvm::Value *, std::shared_ptr<ReturnPropagationPointerFact>>
-      input_facts;
-  std::unordered_map<llvm::Value *, std::shared_ptr<ReturnPropagationPointerFact>>
-      output_facts;
+  errspec::FactTable<ReturnPropagationPointerFact> input_facts;
+  errspec::FactTable<ReturnPropagationPointerFact> output_facts;
 
-  uint64_t next_idx = 0;
+  // Counters for fresh MemIndexes, one per function so that functions can
+  // be analyzed concurrently. MemIndexes never flow between functions.
+  std::unordered_map<const llvm::Function *, uint64_t> next_idx;
+  MemVal freshMemIndex(const llvm::Instruction &I);
 
   bool finished = false;
 
   // If memory is going to be written to, use this to prevent creation of
   // extra reference MemVals
-  std::unordered_set<MemVal>& findOrCreateMemVal(ReturnPropagationPointerFact &rpf, const MemVal &idx);
+  std::unordered_set<MemVal>& findOrCreateMemVal(ReturnPropagationPointerFact &rpf, const MemVal &idx, const llvm::Instruction &I);
   std::unordered_set<MemVal>& findOrCreateMemValEmpty(ReturnPropagationPointerFact &rpf, const MemVal &idx);
   std::unordered_set<MemVal>& createMemValEmpty(ReturnPropagationPointerFact &rpf, const MemVal &idx);
   bool haveMemVal(const ReturnPropagationPointerFact &rpf, const MemVal &idx);
 
-  bool visitBlock(llvm::BasicBlock &BB);
+  void visitBlock(llvm::BasicBlock &BB);
 
   void visitCallInst(llvm::CallInst &I,
                      std::shared_ptr<const ReturnPropagationPointerFact> input,
@@ -2,8 +2,11 @@
 #include <string>
 
 #include "Common.h"
+#include "Dataflow.hpp"
+#include "CallSiteIndex.h"
 #include "ReturnedValues.h"
 #include "llvm/IR/CFG.h"
+#include <glog/logging.h>
 
 using namespace llvm;
 using namespace std;
@@ -11,56 +14,30 @@ using namespace errspec;
 
 #define DEBUG false
 
+// Instructions that visitBlock copies the fact across unchanged
+static bool isTransparent(const Instruction &I) {
+  return !isa<ReturnInst>(I) && !isa<CallInst>(I) && !isa<LoadInst>(I)
+         && !isa<StoreInst>(I) && !isa<BitCastInst>(I) && !isa<PtrToIntInst>(I)
+         && !isa<TruncInst>(I) && !isa<SExtInst>(I) && !isa<PHINode>(I);
+}
+
 bool ReturnedValues::runOnModule(Module &M) {
-  // Initialize program points to empty ReturnedValuesFact
-  // Creates a new fact at every point
-  std::shared_ptr<ReturnedValuesFact> prev = nullptr;
-  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-    for (auto bi = fi->begin(), be = fi->end(); bi != be; ++bi) {
-      for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
-        Instruction *inst = &(*ii);
-        if (prev == nullptr) {
-          input_facts[inst] = std::make_shared<ReturnedValuesFact>();
-        } else {
-          input_facts[inst] = prev;
-        }
-        auto out = std::make_shared<ReturnedValuesFact>();
-        output_facts[inst] = out;
-        prev = out;
-      }
-      prev = nullptr;
-    }
-  }
+  initFacts(getAnalysis<InstructionNumbering>(), input_facts, output_facts);
+  call_sites = &getAnalysis<CallSiteIndex>();
 
-  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
-    runOnFunction(*fi);
-  }
+  stats = solveFunctions(M, jobs, scope,
+                         [this](Function &F) { return runOnFunction(F); });
+  LOG(INFO) << "ReturnedValues: " << stats.visits << " block visits for "
+            << stats.blocks << " blocks";
 
   return false;
 }
 
-void ReturnedValues::runOnFunction(Function &F) {
-  string fname = F.getName().str();
-
-  bool changed = true;
-  while (changed) {
-    changed = false;
-    for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
-      BasicBlock *BB = &*bi;
-
-      Instruction *bb_last = GetLastInstructionOfBB(BB);
-      auto bb_out_fact = output_facts.at(bb_last);
-
-      // Go over successor blocks and apply join
-      for (auto si = succ_begin(BB), se = succ_end(BB); si != se; ++si) {
-        Instruction *succ_first = &(*(si->begin()));
-        auto succ_fact = input_facts.at(succ_first);
-        bb_out_fact->join(*succ_fact);
-      }
-
-      changed = visitBlock(*BB) || changed;
-    }
-  }
+DataflowStats ReturnedValues::runOnFunction(Function &F) {
+  createFacts(F, input_facts, output_facts, isTransparent);
+  DataflowStats function_stats = solveDataflow<Direction::Backward>(
+      F, input_facts, output_facts,
+      [this](BasicBlock &BB) { return visitBlock(BB); });
 
   if (DEBUG) {
     for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
@@ -76,47 +53,72 @@ void ReturnedValues::runOnFunction(Function &F) {
     }
   }
 
-  return;
+  pruneFacts(F, input_facts, output_facts, retention);
+  return function_stats;
 }
 
+// Returns true if the fact at the entry of the block changed, or if a PHI
+// node added values to the exit fact of a predecessor
 bool ReturnedValues::visitBlock(BasicBlock &BB) {
-  bool changed = false;
-  for (auto ii = BB.rbegin(), ie = BB.rend(); ii != ie; ++ii) {
+  shared_ptr<ReturnedValuesFact> bb_in_fact = input_facts.at(&BB.front());
+  ReturnedValuesFact prev_fact = *bb_in_fact;
+  bool predecessor_changed = false;
+
+  unsigned slot = input_facts.getNumbering().getLast(&BB);
+  for (auto ii = BB.rbegin(), ie = BB.rend(); ii != ie; ++ii, --slot) {
     Instruction &I = *ii;
 
-    shared_ptr<ReturnedValuesFact> input_fact = input_facts.at(&I);
-    shared_ptr<ReturnedValuesFact> output_fact = output_facts.at(&I);
-
-    ReturnedValuesFact prev_fact = *input_fact;
-    if (ReturnInst *inst = dyn_cast<ReturnInst>(&I)) {
-      visitReturnInst(*inst, input_fact, output_fact);
-    } else if (CallInst *inst = dyn_cast<CallInst>(&I)) {
-      visitCallInst(*inst, input_fact, output_fact);
-    } else if (LoadInst *inst = dyn_cast<LoadInst>(&I)) {
-      visitLoadInst(*inst, input_fact, output_fact);
-    } else if (StoreInst *inst = dyn_cast<StoreInst>(&I)) {
-      visitStoreInst(*inst, input_fact, output_fact);
-    } else if (BitCastInst *inst = dyn_cast<BitCastInst>(&I)) {
-      visitBitCastInst(*inst, input_fact, output_fact);
-    } else if (PtrToIntInst *inst = dyn_cast<PtrToIntInst>(&I)) {
-      visitPtrToIntInst(*inst, input_fact, output_fact);
-    } else if (TruncInst *inst = dyn_cast<TruncInst>(&I)) {
-      visitTruncInst(*inst, input_fact, output_fact);
-    } else if (SExtInst *inst = dyn_cast<SExtInst>(&I)) {
-      visitSExtInst(*inst, input_fact, output_fact);
-    } else if (PHINode *inst = dyn_cast<PHINode>(&I)) {
-      visitPHINode(*inst, input_fact, output_fact);
-    } else {
-      // Default is to just copy facts from previous instruction unchanged.
-      input_fact->value = output_fact->value;
+    shared_ptr<ReturnedValuesFact> input_fact = input_facts[slot];
+    shared_ptr<ReturnedValuesFact> output_fact = output_facts[slot];
+
+    // Transparent instructions share one fact, there is nothing to copy
+    if (input_fact == output_fact) {
+      continue;
     }
-    changed = changed || (*(input_fact) != prev_fact);
+
+    predecessor_changed =
+        visitInstruction(I, input_fact, output_fact) || predecessor_changed;
   }
 
-  return changed;
+  return predecessor_changed || *bb_in_fact != prev_fact;
+}
+
+// Returns true if I is a PHI node that added values to the exit fact of a
+// predecessor
+bool ReturnedValues::visitInstruction(Instruction &I,
+                                      shared_ptr<ReturnedValuesFact> in,
+                                      shared_ptr<const ReturnedValuesFact> out) {
+  if (ReturnInst *inst = dyn_cast<ReturnInst>(&I)) {
+    visitReturnInst(*inst, in, out);
+  } else if (CallInst *inst = dyn_cast<CallInst>(&I)) {
+    visitCallInst(*inst, in, out);
+  } else if (LoadInst *inst = dyn_cast<LoadInst>(&I)) {
+    visitLoadInst(*inst, in, out);
+  } else if (StoreInst *inst = dyn_cast<StoreInst>(&I)) {
+    visitStoreInst(*inst, in, out);
+  } else if (BitCastInst *inst = dyn_cast<BitCastInst>(&I)) {
+    visitBitCastInst(*inst, in, out);
+  } else if (PtrToIntInst *inst = dyn_cast<PtrToIntInst>(&I)) {
+    visitPtrToIntInst(*inst, in, out);
+  } else if (TruncInst *inst = dyn_cast<TruncInst>(&I)) {
+    visitTruncInst(*inst, in, out);
+  } else if (SExtInst *inst = dyn_cast<SExtInst>(&I)) {
+    visitSExtInst(*inst, in, out);
+  } else if (PHINode *inst = dyn_cast<PHINode>(&I)) {
+    return visitPHINode(*inst, in, out);
+  } else {
+    // Default is to just copy facts from previous instruction unchanged.
+    in->value = out->value;
+  }
+  return false;
+}
+
+bool ReturnedValues::isReplayUnsafe(const Instruction &I) {
+  return isa<CallInst>(I) || isa<PHINode>(I);
 }
 
 void ReturnedValues::addReturnPropagated(Function *f, string v) {
+  lock_guard<mutex> lock(return_propagated_mutex);
   if (return_propagated.find(f) == return_propagated.end()) {
     return_propagated[f] = unordered_set<string>({v});
   } else {
@@ -129,47 +131,21 @@ void ReturnedValues::visitCallInst(CallInst &I,
                                    shared_ptr<const ReturnedValuesFact> out) {
   in->value = out->value;
 
-  string fname = getCalleeName(I);
+  if (out->value.find(&I) == out->value.end())
+    return;
+  const CallSiteIndex::CallInfo &info = call_sites->getCallInfo(I);
+  const string &fname = call_sites->getFunctionIds().getName(info.id);
   if (fname.empty())
     return;
   Function *parent = I.getParent()->getParent();
 
   // Add every call instruction that can be returned to return propagated map
-  if (out->value.find(&I) != out->value.end()) {
-    addReturnPropagated(parent, fname);
-  }
-
-  // Model ERR_PTR
-  // LLVM creates multiple copies with numbers at end ERR_PTR116
-  if (fname.find("ERR_PTR") != string::npos) {
-    Value *err = I.getOperand(0);
-    if (out->value.find(&I) != out->value.end()) {
-      in->value.insert(err);
-    }
-  }
+  addReturnPropagated(parent, fname);
 
-  // Model IS_ERR
-  if (fname.find("IS_ERR") != string::npos) {
-    Value *err = I.getOperand(0);
-    if (out->value.find(&I) != out->value.end()) {
-      in->value.insert(err);
-    }
-  }
-
-  // Model PTR_ERR
-  if (fname.find("PTR_ERR") != string::npos) {
-    Value *err = I.getOperand(0);
-    if (out->value.find(&I) != out->value.end()) {
-      in->value.insert(err);
-    }
-  }
-
-  // Model ERR_CAST
-  if (fname.find("PTR_ERR") != string::npos) {
-    Value *err = I.getOperand(0);
-    if (out->value.find(&I) != out->value.end()) {
-      in->value.insert(err);
-    }
+  // Error constructors, tests and pass-throughs can return the error value
+  // in their first argument
+  if (info.model != ModelKind::None && I.getNumArgOperands() > 0) {
+    in->value.insert(I.getArgOperand(0));
   }
 }
 
@@ -261,15 +237,17 @@ void ReturnedValues::visitSExtInst(
 
 // If the PHI result can be returned, then add incoming values
 // to the exit of each incoming basic block
-void ReturnedValues::visitPHINode(PHINode &I, shared_ptr<ReturnedValuesFact> in,
+// Returns true if the exit fact of an incoming block changed
+bool ReturnedValues::visitPHINode(PHINode &I, shared_ptr<ReturnedValuesFact> in,
                                   shared_ptr<const ReturnedValuesFact> out) {
 
   in->value = out->value;
   if (out->value.find(&I) == out->value.end()) {
-    return;
+    return false;
   }
   in->value.erase(&I);
 
+  bool changed = false;
   for (unsigned i = 0, e = I.getNumIncomingValues(); i != e; ++i) {
     Value *v = I.getIncomingValue(i);
     BasicBlock *BB = I.getIncomingBlock(i);
@@ -277,19 +255,35 @@ void ReturnedValues::visitPHINode(PHINode &I, shared_ptr<ReturnedValuesFact> in,
 
     // insert v into the output fact of the last instruction
     auto bb_out_fact = output_facts.at(bb_last);
-    bb_out_fact->value.insert(v);
+    changed = bb_out_fact->value.insert(v).second || changed;
   }
+
+  return changed;
+}
+
+ReturnedValuesFact ReturnedValues::getInFact(Value *v) {
+  return *getFact(*cast<Instruction>(v), true);
 }
 
-ReturnedValuesFact ReturnedValues::getInFact(Value *v) const {
-  return *(input_facts.at(v));
+ReturnedValuesFact ReturnedValues::getOutFact(Value *v) {
+  return *getFact(*cast<Instruction>(v), false);
 }
 
-ReturnedValuesFact ReturnedValues::getOutFact(Value *v) const {
-  return *(output_facts.at(v));
+// Replays I's block backwards from the nearest kept fact if the fact was
+// not kept
+shared_ptr<ReturnedValuesFact> ReturnedValues::getFact(Instruction &I,
+                                                       bool input) {
+  return replayFact<Direction::Backward>(
+      I, input, input_facts, output_facts,
+      [this](Instruction &J, shared_ptr<ReturnedValuesFact> in,
+             shared_ptr<const ReturnedValuesFact> out) {
+        visitInstruction(J, in, out);
+      });
 }
 
 void ReturnedValues::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<InstructionNumbering>();
+  AU.addRequired<CallSiteIndex>();
   AU.setPreservesAll();
 }
 
@@ -33,10 +33,11 @@
 //            example, if %5 = phi [%1, BB1] [%2, BB2] can be returned,
 //            then %1 can be returned at the exit of BB1 and %2 can
 //            be returned at the exit of BB2.
+// - CallInst: if the result of a call to a function with an error model
+//             (see ErrorModels.h) can be returned, then so can its first
+//             argument
 //
 // Sets are unioned at join points (forward branches).
-//
-// The Linux function ERR_PTR is modeled in visitCallInst
 
 // Limitations
 // ------------
@@ -47,14 +48,18 @@
 #define RETURNEDVALUES_H
 
 #include "Constraint.h"
+#include "Dataflow.hpp"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 
+class CallSiteIndex;
+
 class ReturnedValuesFact {
 public:
   std::unordered_set<llvm::Value *> value;
@@ -96,23 +101,47 @@ class ReturnedValues : public llvm::ModulePass {
 public:
   static char ID;
 
-  ReturnedValues() : llvm::ModulePass(ID) {}
+  ReturnedValues() : llvm::ModulePass(ID) { retention.keep(isReplayUnsafe); }
+  explicit ReturnedValues(unsigned jobs) : llvm::ModulePass(ID), jobs(jobs) {
+    retention.keep(isReplayUnsafe);
+  }
 
   // Entry point
   bool runOnModule(llvm::Module &M);
 
   // Called for each function
-  void runOnFunction(llvm::Function &F);
+  errspec::DataflowStats runOnFunction(llvm::Function &F);
 
   std::unordered_map<llvm::Function *, std::unordered_set<std::string>>
   getReturnPropagation() const;
 
-  ReturnedValuesFact getInFact(llvm::Value *) const;
-  ReturnedValuesFact getOutFact(llvm::Value *) const;
+  // Facts at points that were not kept are recomputed
+  ReturnedValuesFact getInFact(llvm::Value *);
+  ReturnedValuesFact getOutFact(llvm::Value *);
+
+  // Program points whose facts are kept once a function is solved
+  errspec::FactRetention retention;
+
+  // Functions that are solved
+  errspec::FunctionScope scope;
+
+  // Worklist iteration counts over the module
+  errspec::DataflowStats stats;
+
+  // Number of threads solving functions
+  unsigned jobs = 1;
 
 private:
   // Called for each basic block
   bool visitBlock(llvm::BasicBlock &BB);
+  bool visitInstruction(llvm::Instruction &I,
+                        std::shared_ptr<ReturnedValuesFact> input,
+                        std::shared_ptr<const ReturnedValuesFact> out);
+  std::shared_ptr<ReturnedValuesFact> getFact(llvm::Instruction &I, bool input);
+
+  // Calls and PHI nodes write outside their own facts, so their facts are
+  // always kept and never replayed
+  static bool isReplayUnsafe(const llvm::Instruction &I);
 
   // Transfer functions
   void visitReturnInst(llvm::ReturnInst &I,
@@ -139,7 +168,7 @@ private:
   void visitSExtInst(llvm::SExtInst &I,
                      std::shared_ptr<ReturnedValuesFact> input,
                      std::shared_ptr<const ReturnedValuesFact> out);
-  void visitPHINode(llvm::PHINode &I, std::shared_ptr<ReturnedValuesFact> input,
+  bool visitPHINode(llvm::PHINode &I, std::shared_ptr<ReturnedValuesFact> input,
                     std::shared_ptr<const ReturnedValuesFact> out);
 
   virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const;
@@ -147,17 +176,19 @@ private:
   // Helper function for adding values to return_propagated map
   void addReturnPropagated(llvm::Function *, std::string);
 
-  // A map from values (instructions) to dataflow facts
-  std::unordered_map<llvm::Value *, std::shared_ptr<ReturnedValuesFact>>
-      input_facts;
+  // Callees and their error models, resolved once per call
+  CallSiteIndex *call_sites = nullptr;
+
+  // Dataflow facts by instruction number
+  errspec::FactTable<ReturnedValuesFact> input_facts;
 
-  // A map from values (instructions) to dataflow facts
-  std::unordered_map<llvm::Value *, std::shared_ptr<ReturnedValuesFact>>
-      output_facts;
+  // Dataflow facts by instruction number
+  errspec::FactTable<ReturnedValuesFact> output_facts;
 
   // A map from functions to propagated functions
   std::unordered_map<llvm::Function *, std::unordered_set<std::string>>
       return_propagated;
+  std::mutex return_propagated_mutex;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+// A hash map that can be read and written from several threads. Keys are
+// spread over independently locked shards so that threads working on
+// different keys rarely wait on each other.
+
+#ifndef SHARDEDMAP_HPP
+#define SHARDEDMAP_HPP
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace errspec {
+
+template <class K, class V, class Hash = std::hash<K>> class ShardedMap {
+public:
+  explicit ShardedMap(unsigned num_shards = 64)
+      : num_shards(num_shards), shards(new Shard[num_shards]) {}
+
+  bool contains(const K &key) const {
+    const Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.map.find(key) != shard.map.end();
+  }
+
+  // Copies the value for key into value. Returns false if there is none.
+  bool get(const K &key, V &value) const {
+    const Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+      return false;
+    }
+    value = it->second;
+    return true;
+  }
+
+  V at(const K &key) const {
+    V value;
+    if (!get(key, value)) {
+      throw std::out_of_range("ShardedMap::at");
+    }
+    return value;
+  }
+
+  void set(const K &key, const V &value) {
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.map[key] = value;
+  }
+
+  void clear() {
+    for (unsigned i = 0; i < num_shards; ++i) {
+      std::lock_guard<std::mutex> lock(shards[i].mutex);
+      shards[i].map.clear();
+    }
+  }
+
+  // A copy of the whole map. Not atomic with respect to concurrent writers.
+  std::unordered_map<K, V, Hash> snapshot() const {
+    std::unordered_map<K, V, Hash> ret;
+    for (unsigned i = 0; i < num_shards; ++i) {
+      std::lock_guard<std::mutex> lock(shards[i].mutex);
+      ret.insert(shards[i].map.begin(), shards[i].map.end());
+    }
+    return ret;
+  }
+
+private:
+  struct Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<K, V, Hash> map;
+  };
+
+  unsigned num_shards;
+  std::unique_ptr<Shard[]> shards;
+
+  Shard &shardFor(const K &key) { return shards[Hash()(key) % num_shards]; }
+  const Shard &shardFor(const K &key) const {
+    return shards[Hash()(key) % num_shards];
+  }
+};
+
+} // namespace errspec
+
+#endif
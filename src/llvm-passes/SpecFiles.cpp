@@ -0,0 +1,76 @@
+#include "SpecFiles.h"
+#include "SpecSnapshot.h"
+#include <boost/algorithm/string.hpp>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+namespace errspec {
+
+unordered_set<string> readErrorOnlyFile(const string &path) {
+  unordered_set<string> error_only;
+  string line;
+
+  ifstream error_only_file(path);
+  while (getline(error_only_file, line)) {
+    error_only.insert(line);
+  }
+
+  return error_only;
+}
+
+// A snapshot is read without parsing; one that cannot be mapped is reported
+// and empty
+static unordered_map<string, Constraint> readSnapshot(const string &path) {
+  string error;
+  unique_ptr<SpecSnapshot> snapshot = SpecSnapshot::open(path, error);
+  if (!snapshot) {
+    cerr << "WARNING: " << path << ": " << error << "\n";
+    return {};
+  }
+  return snapshot->toMap();
+}
+
+unordered_map<string, Constraint> readInputSpecsFile(const string &path) {
+  if (SpecSnapshot::isSnapshot(path)) {
+    return readSnapshot(path);
+  }
+
+  unordered_map<string, Constraint> specs;
+  string line;
+
+  ifstream specs_file(path);
+  while (getline(specs_file, line)) {
+    // need to split fname from spec
+    vector<string> fields;
+    boost::split(fields, line, boost::is_any_of(" "));
+    string fname = fields[0];
+    specs[fname] = Constraint(fname, fields[1]);
+  }
+
+  return specs;
+}
+
+unordered_map<string, Constraint> readSpecsFile(const string &path) {
+  if (SpecSnapshot::isSnapshot(path)) {
+    return readSnapshot(path);
+  }
+
+  unordered_map<string, Constraint> specs;
+  string line;
+
+  // The first field is the name followed by a colon
+  ifstream specs_file(path);
+  while (getline(specs_file, line)) {
+    vector<string> fields;
+    boost::split(fields, line, boost::is_any_of(" "));
+    string fname = fields[1];
+    specs[fname] = Constraint(fname, fields[2]);
+  }
+
+  return specs;
+}
+
+} // namespace errspec
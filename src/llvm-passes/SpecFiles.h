@@ -0,0 +1,32 @@
+// Readers for the text files that configure the analyses. They are read
+// once by main and handed to the passes, so that a batch of modules does
+// not read them again for every module.
+//
+// error-only file: one function name per line
+// input specs file: "fname interval" per line
+// specs file: "fname: fname interval" per line, as printed by the specs
+// command
+//
+// Both specs files can also be binary snapshots (see SpecSnapshot.h).
+
+#ifndef SPECFILES_H
+#define SPECFILES_H
+
+#include "Constraint.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace errspec {
+
+std::unordered_set<std::string> readErrorOnlyFile(const std::string &path);
+
+std::unordered_map<std::string, Constraint>
+readInputSpecsFile(const std::string &path);
+
+std::unordered_map<std::string, Constraint>
+readSpecsFile(const std::string &path);
+
+} // namespace errspec
+
+#endif
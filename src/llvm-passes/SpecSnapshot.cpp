@@ -0,0 +1,178 @@
+#include "SpecSnapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace llvm;
+using namespace std;
+
+namespace errspec {
+
+static const char magic[8] = {'E', 'E', 'S', 'I', 'S', 'P', 'E', 'C'};
+
+namespace {
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t count;
+  uint64_t strings_size;
+};
+
+size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+size_t intervalWords(size_t count) {
+  return (count + IntervalVector::lanes_per_word - 1) /
+         IntervalVector::lanes_per_word;
+}
+
+} // namespace
+
+unique_ptr<SpecSnapshot> SpecSnapshot::open(const string &path,
+                                            string &error) {
+  ErrorOr<unique_ptr<MemoryBuffer>> file =
+      MemoryBuffer::getFile(path, -1, false);
+  if (!file) {
+    error = file.getError().message();
+    return nullptr;
+  }
+
+  unique_ptr<SpecSnapshot> snapshot(new SpecSnapshot());
+  snapshot->buffer = std::move(*file);
+  const char *start = snapshot->buffer->getBufferStart();
+  size_t size = snapshot->buffer->getBufferSize();
+
+  Header header;
+  if (size < sizeof(Header)) {
+    error = "not a spec snapshot";
+    return nullptr;
+  }
+  memcpy(&header, start, sizeof(Header));
+  if (memcmp(header.magic, magic, sizeof(magic)) != 0) {
+    error = "not a spec snapshot";
+    return nullptr;
+  }
+  if (header.version != SPEC_SNAPSHOT_VERSION) {
+    error = "spec snapshot version " + to_string(header.version) +
+            ", expected " + to_string(SPEC_SNAPSHOT_VERSION);
+    return nullptr;
+  }
+
+  size_t index_offset = sizeof(Header);
+  size_t intervals_offset =
+      align8(index_offset + header.count * sizeof(Entry));
+  size_t strings_offset =
+      intervals_offset + intervalWords(header.count) * sizeof(uint64_t);
+  // Compared so that a huge strings_size cannot wrap around
+  if (strings_offset > size || header.strings_size > size - strings_offset) {
+    error = "truncated spec snapshot";
+    return nullptr;
+  }
+
+  snapshot->count = header.count;
+  snapshot->index = reinterpret_cast<const Entry *>(start + index_offset);
+  snapshot->intervals =
+      reinterpret_cast<const uint64_t *>(start + intervals_offset);
+  snapshot->strings = start + strings_offset;
+  for (uint32_t i = 0; i < header.count; ++i) {
+    const Entry &entry = snapshot->index[i];
+    if (uint64_t(entry.offset) + entry.length > header.strings_size) {
+      error = "corrupt spec snapshot";
+      return nullptr;
+    }
+  }
+  return snapshot;
+}
+
+bool SpecSnapshot::isSnapshot(const string &path) {
+  char start[sizeof(magic)];
+  ifstream file(path, ios::binary);
+  return file.read(start, sizeof(start)) &&
+         memcmp(start, magic, sizeof(magic)) == 0;
+}
+
+StringRef SpecSnapshot::name(size_t i) const {
+  return StringRef(strings + index[i].offset, index[i].length);
+}
+
+Interval SpecSnapshot::interval(size_t i) const {
+  uint64_t word = intervals[i / IntervalVector::lanes_per_word];
+  unsigned shift =
+      IntervalVector::lane_bits * (i % IntervalVector::lanes_per_word);
+  return static_cast<Interval>((word >> shift) & 7);
+}
+
+bool SpecSnapshot::find(StringRef fname, Interval &interval) const {
+  size_t lo = 0, hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    int cmp = name(mid).compare(fname);
+    if (cmp == 0) {
+      interval = this->interval(mid);
+      return true;
+    }
+    if (cmp < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return false;
+}
+
+unordered_map<string, Constraint> SpecSnapshot::toMap() const {
+  unordered_map<string, Constraint> specs;
+  for (size_t i = 0; i < count; ++i) {
+    string fname = name(i);
+    Constraint c(fname);
+    c.interval = interval(i);
+    specs[fname] = c;
+  }
+  return specs;
+}
+
+void writeSpecSnapshot(const unordered_map<string, Constraint> &specs,
+                       ostream &out) {
+  // Sorted as StringRef::compare orders them, for find
+  vector<string> names;
+  for (const auto &spec : specs) {
+    names.push_back(spec.first);
+  }
+  std::sort(names.begin(), names.end(), [](const string &a, const string &b) {
+    return StringRef(a).compare(b) < 0;
+  });
+
+  Header header;
+  memcpy(header.magic, magic, sizeof(magic));
+  header.version = SPEC_SNAPSHOT_VERSION;
+  header.count = names.size();
+  header.strings_size = 0;
+
+  vector<uint32_t> index;
+  vector<uint64_t> words(intervalWords(names.size()));
+  string strings;
+  for (size_t i = 0; i < names.size(); ++i) {
+    index.push_back(strings.size());
+    index.push_back(names[i].size());
+    strings += names[i];
+
+    uint8_t bits = intervalBits(specs.at(names[i]).interval);
+    words[i / IntervalVector::lanes_per_word] |=
+        uint64_t(bits)
+        << (IntervalVector::lane_bits * (i % IntervalVector::lanes_per_word));
+  }
+  header.strings_size = strings.size();
+
+  size_t index_size = index.size() * sizeof(uint32_t);
+  static const char padding[8] = {0};
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(index.data()), index_size);
+  out.write(padding, align8(sizeof(header) + index_size) -
+                         (sizeof(header) + index_size));
+  out.write(reinterpret_cast<const char *>(words.data()),
+            words.size() * sizeof(uint64_t));
+  out.write(strings.data(), strings.size());
+}
+
+} // namespace errspec
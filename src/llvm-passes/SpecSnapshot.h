@@ -0,0 +1,71 @@
+// A binary file of specifications that is mapped into memory and read in
+// place, without parsing. It replaces the text specs and input specs files
+// where the same large set of specifications is read by many runs.
+//
+// Layout, in native byte order, every section 8-byte aligned:
+//
+//   header:     char magic[8] = "EESISPEC", uint32 version, uint32 count,
+//               uint64 strings_size
+//   index:      count x {uint32 offset, uint32 length} of the names in the
+//               string table, sorted by name
+//   intervals:  the interval of each name, in index order, packed as in
+//               IntervalVector: 3 bits each, 21 to a uint64
+//   strings:    the names, concatenated
+//
+// Bump SPEC_SNAPSHOT_VERSION when the layout changes; older snapshots are
+// then rejected.
+
+#ifndef SPECSNAPSHOT_H
+#define SPECSNAPSHOT_H
+
+#include "Constraint.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#define SPEC_SNAPSHOT_VERSION 1
+
+namespace errspec {
+
+class SpecSnapshot {
+public:
+  // Returns null and sets error if path cannot be mapped or is not a
+  // snapshot of this version
+  static std::unique_ptr<SpecSnapshot> open(const std::string &path,
+                                            std::string &error);
+
+  // True if the file at path starts like a snapshot
+  static bool isSnapshot(const std::string &path);
+
+  size_t size() const { return count; }
+  llvm::StringRef name(size_t i) const;
+  Interval interval(size_t i) const;
+
+  // Binary search of the index. Returns false if fname has no spec.
+  bool find(llvm::StringRef fname, Interval &interval) const;
+
+  // For the users that need a map; parses nothing
+  std::unordered_map<std::string, Constraint> toMap() const;
+
+private:
+  struct Entry {
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  std::unique_ptr<llvm::MemoryBuffer> buffer;
+  uint32_t count = 0;
+  const Entry *index = nullptr;
+  const uint64_t *intervals = nullptr;
+  const char *strings = nullptr;
+};
+
+void writeSpecSnapshot(const std::unordered_map<std::string, Constraint> &specs,
+                       std::ostream &out);
+
+} // namespace errspec
+
+#endif
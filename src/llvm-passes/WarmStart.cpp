@@ -0,0 +1,148 @@
+#include "WarmStart.h"
+#include "AnalysisCache.h"
+#include "CallGraphSCCs.h"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <vector>
+
+using namespace llvm;
+using namespace std;
+
+namespace errspec {
+
+void writeWarmStart(const WarmStart &warm_start, ostream &out) {
+  out << "config " << warm_start.config << "\n";
+
+  map<string, string> hashes(warm_start.hashes.begin(),
+                             warm_start.hashes.end());
+  for (const auto &hash : hashes) {
+    out << "function " << hash.first << " " << hash.second << "\n";
+  }
+
+  map<string, Constraint> specs(warm_start.specs.begin(),
+                                warm_start.specs.end());
+  for (const auto &spec : specs) {
+    out << "spec " << spec.first << " " << spec.second.interval << "\n";
+  }
+
+  for (const auto &edge : warm_start.error_propagation) {
+    out << "edge " << edge.first << " " << edge.second << "\n";
+  }
+
+  set<string> bootstrap(warm_start.error_only_bootstrap.begin(),
+                        warm_start.error_only_bootstrap.end());
+  for (const string &fname : bootstrap) {
+    out << "erroronly " << fname << "\n";
+  }
+}
+
+bool readWarmStart(istream &in, WarmStart &warm_start) {
+  string line;
+  while (getline(in, line)) {
+    istringstream fields(line);
+    string kind, first, second;
+    fields >> kind >> first;
+    if (first.empty()) {
+      return false;
+    }
+
+    if (kind == "config") {
+      warm_start.config = first;
+    } else if (kind == "function") {
+      if (!(fields >> second)) {
+        return false;
+      }
+      warm_start.hashes[first] = second;
+    } else if (kind == "spec") {
+      Interval interval;
+      if (!(fields >> second) || !parseInterval(second, interval)) {
+        return false;
+      }
+      Constraint c(first);
+      c.interval = interval;
+      warm_start.specs[first] = c;
+    } else if (kind == "edge") {
+      if (!(fields >> second)) {
+        return false;
+      }
+      warm_start.error_propagation.insert(make_pair(first, second));
+    } else if (kind == "erroronly") {
+      warm_start.error_only_bootstrap.insert(first);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+string hashConfig(const unordered_set<string> &error_only,
+                  const unordered_map<string, Constraint> &input_specs,
+                  const vector<string> &tables) {
+  vector<string> parts;
+  for (const string &fname : error_only) {
+    parts.push_back("erroronly " + fname);
+  }
+  for (const auto &spec : input_specs) {
+    ostringstream part;
+    part << "spec " << spec.first << " " << spec.second.interval;
+    parts.push_back(part.str());
+  }
+  std::sort(parts.begin(), parts.end());
+  for (const string &line : tables) {
+    parts.push_back("table " + line);
+  }
+  return hashStrings(parts);
+}
+
+unordered_map<string, string> hashFunctions(Module &M, unsigned jobs) {
+  vector<Function *> functions;
+  for (Function &F : M) {
+    functions.push_back(&F);
+  }
+  vector<string> function_hashes(functions.size());
+  parallelFor(jobs, functions.size(), [&](size_t i) {
+    function_hashes[i] = hashFunction(*functions[i]);
+  });
+
+  unordered_map<string, string> hashes;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    hashes[functions[i]->getName()] = function_hashes[i];
+  }
+  return hashes;
+}
+
+unordered_set<const Function *>
+dirtyFunctions(Module &M, const WarmStart &previous,
+               const unordered_map<string, string> &hashes,
+               const string &config) {
+  unordered_set<const Function *> dirty;
+  bool same_config = previous.config == config;
+
+  // Changed functions, then their callers
+  CallGraphSCCs call_graph(M);
+  vector<const Function *> worklist;
+  for (Function &F : M) {
+    auto previous_hash = previous.hashes.find(F.getName());
+    if (same_config && previous_hash != previous.hashes.end() &&
+        previous_hash->second == hashes.at(F.getName())) {
+      continue;
+    }
+    if (F.isDeclaration() || dirty.insert(&F).second) {
+      worklist.push_back(&F);
+    }
+  }
+  while (!worklist.empty()) {
+    const Function *F = worklist.back();
+    worklist.pop_back();
+    for (Function *caller : call_graph.getCallers(F->getName())) {
+      if (dirty.insert(caller).second) {
+        worklist.push_back(caller);
+      }
+    }
+  }
+  return dirty;
+}
+
+} // namespace errspec
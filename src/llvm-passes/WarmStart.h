@@ -0,0 +1,72 @@
+// The results of a previous run of ErrorBlocks, for starting the next run on
+// the same program from them instead of from scratch.
+//
+// The specification of a function depends only on its IR, the
+// specifications of its callees and the configuration (error-only functions
+// and input specifications). A function is dirty if its IR changed, if it is
+// new, or if it calls a dirty function; its callers are then dirty too. The
+// specification, error propagation edges and error-only seed of a clean
+// function are taken from the previous run, and only the dirty functions are
+// solved again. ErrorBlocks solves callees before callers, so a dirty
+// function sees the callee specifications of a cold run and ends up with the
+// same results. A changed configuration makes every function dirty.
+//
+// Text format, one record per line:
+//
+//   config HASH
+//   function NAME HASH
+//   spec NAME INTERVAL
+//   edge FROM TO
+//   erroronly NAME
+
+#ifndef WARMSTART_H
+#define WARMSTART_H
+
+#include "Constraint.h"
+#include "llvm/IR/Module.h"
+#include <iostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace errspec {
+
+struct WarmStart {
+  // Hash of the configuration
+  std::string config;
+
+  // Hash of the IR of every function of the module, declarations included
+  std::unordered_map<std::string, std::string> hashes;
+
+  std::unordered_map<std::string, Constraint> specs;
+  std::set<std::pair<std::string, std::string>> error_propagation;
+  std::unordered_set<std::string> error_only_bootstrap;
+};
+
+// Records are written sorted, so the file does not depend on jobs
+void writeWarmStart(const WarmStart &warm_start, std::ostream &out);
+bool readWarmStart(std::istream &in, WarmStart &warm_start);
+
+// The error models and error codes are formatted lines, hashed in order
+std::string
+hashConfig(const std::unordered_set<std::string> &error_only,
+           const std::unordered_map<std::string, Constraint> &input_specs,
+           const std::vector<std::string> &tables);
+
+// Hash of every function of M by name, computed on up to jobs threads
+std::unordered_map<std::string, std::string> hashFunctions(llvm::Module &M,
+                                                           unsigned jobs);
+
+// The defined functions of M that must be solved again, given the hashes and
+// configuration of this run
+std::unordered_set<const llvm::Function *>
+dirtyFunctions(llvm::Module &M, const WarmStart &previous,
+               const std::unordered_map<std::string, std::string> &hashes,
+               const std::string &config);
+
+} // namespace errspec
+
+#endif
@@ -1,14 +1,21 @@
 import argparse
+import sqlite3
 
 parser = argparse.ArgumentParser()
-parser.add_argument('bugs', help="Path to bugs file")
+parser.add_argument('bugs', help="Path to bugs file, or to a database written by the errdb command")
 args = parser.parse_args()
 
 def confidence(unchecked, checked):
 	return float(checked) / (float(unchecked) + float(checked))
 
-with open(args.bugs, "r") as f:
-	lines = [x.strip().split() for x in f.readlines()]
+if args.bugs.endswith(".db"):
+	db = sqlite3.connect(args.bugs)
+	lines = [[str(x) for x in row] for row in db.execute(
+		"SELECT location, function, unchecked, checked FROM bugs")]
+	db.close()
+else:
+	with open(args.bugs, "r") as f:
+		lines = [x.strip().split() for x in f.readlines()]
 
 lines.sort(key=lambda x: confidence(x[2], x[3]), reverse=True)
 
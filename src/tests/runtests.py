@@ -1,6 +1,9 @@
 import os
+import shutil
 import subprocess
 import difflib
+import sqlite3
+import tempfile
 
 def main():
     # For every subdirectory that starts with the word test
@@ -9,15 +12,25 @@ def main():
         if os.path.isdir(di):
             generate_bitcode(di)
             generate_ll_file(di)
-            #passed = test_errspec_specs(di) and passed
+            passed = test_errspec_specs(di) and passed
             passed = test_errspec_bugs(di) and passed
+            passed = test_errspec_cache(di) and passed
+            passed = test_errspec_warmstart(di) and passed
+            passed = test_errspec_jobs(di) and passed
+            passed = test_errspec_summaries(di) and passed
+            passed = test_errspec_errdb(di) and passed
+            passed = test_errspec_snapshot(di) and passed
+            passed = test_errspec_models(di) and passed
+            passed = test_errspec_errorcodes(di) and passed
+            passed = test_errspec_lazy(di) and passed
+    passed = test_errspec_batch() and passed
 
     if passed:
         print("All tests passed.")
 
-def generate_bitcode(test_dir):
-    test_file = test_dir + "/test.c"
-    bc_file = test_dir + "/test.bc"
+def generate_bitcode(test_dir, name="test"):
+    test_file = test_dir + "/" + name + ".c"
+    bc_file = test_dir + "/" + name + ".bc"
     clang = subprocess.Popen(['clang-7', '-c', '-g', '-emit-llvm', '-fno-inline', '-O0',  test_file, '-o', bc_file])
     clang.wait()
 
@@ -29,14 +42,18 @@ def generate_ll_file(test_dir):
 def test_errspec_specs(test_dir):
     test_file = test_dir + "/test.bc"
     try:
-        expected_f = open(test_dir + '/specs.txt', 'r')
+        expected_f = open(test_dir + '/expected-specs.txt', 'r')
         expected_output = "".join(expected_f.readlines())
     except:
         #print("TEST SETUP FAIL: No expected spec output for {}".format(test_file))
         return True 
 
+    # A test directory can have its own error codes
+    error_codes = []
+    if os.path.isfile(test_dir + '/error-codes.txt'):
+        error_codes = ['--errorcodes', test_dir + '/error-codes.txt']
     process = subprocess.Popen(
-        ['../build/eesi', '--command', 'specs', '--bitcode', test_file, '--erroronly', 'test-erroronly.txt', '--inputspecs', 'test-specs.txt'], \
+        ['../build/eesi', '--command', 'specs', '--bitcode', test_file, '--erroronly', 'test-erroronly.txt', '--inputspecs', 'test-specs.txt'] + error_codes, \
         stdout=subprocess.PIPE, stderr=subprocess.PIPE)
     actual_output, error_output = process.communicate()
     if error_output:
@@ -73,6 +90,261 @@ def test_errspec_bugs(test_dir):
 
     return True
 
+def run_eesi(args):
+    process = subprocess.Popen(['../build/eesi'] + args, \
+        stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    output, error_output = process.communicate()
+    return output
+
+# The specs and bugs with --cache, from an empty and from a filled cache, must
+# equal those without it
+def test_errspec_cache(test_dir):
+    test_file = test_dir + "/test.bc"
+    runs = [['--command', 'specs', '--bitcode', test_file, '--erroronly', 'test-erroronly.txt', '--inputspecs', 'test-specs.txt']]
+    specs_file = test_dir + "/specs.txt"
+    if os.path.isfile(specs_file):
+        runs.append(['--command', 'bugs', '--bitcode', test_file, '--specs', specs_file, '--erroronly', 'test-erroronly.txt'])
+
+    passed = True
+    cache_dir = tempfile.mkdtemp()
+    for args in runs:
+        expected_output = run_eesi(args)
+        for cache_state in ["empty", "filled"]:
+            actual_output = run_eesi(args + ['--cache', cache_dir])
+            if (actual_output != expected_output):
+                print("{} {} CACHE FAIL ({} cache). Expected/Actual:".format(test_dir, args[1], cache_state))
+                print('\n'.join(difflib.ndiff([expected_output], [actual_output])))
+                passed = False
+    shutil.rmtree(cache_dir)
+
+    return passed
+
+# Warm starting from test.c, the specs of changed.c must pass
+# --verify-warmstart and equal those of a cold run
+def test_errspec_warmstart(test_dir):
+    if not os.path.isfile(test_dir + "/changed.c"):
+        return True
+    generate_bitcode(test_dir, "changed")
+
+    state_dir = tempfile.mkdtemp()
+    old_specs = state_dir + "/specs.txt"
+    state_file = state_dir + "/state.txt"
+    config = ['--erroronly', 'test-erroronly.txt', '--inputspecs', 'test-specs.txt']
+    run_eesi(['--command', 'specs,warmstart', '--output', old_specs + ',' + state_file, '--bitcode', test_dir + "/test.bc"] + config)
+
+    changed_file = test_dir + "/changed.bc"
+    process = subprocess.Popen(
+        ['../build/eesi', '--command', 'specs', '--bitcode', changed_file, '--warmstart', state_file, '--verify-warmstart'] + config, \
+        stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    actual_output, error_output = process.communicate()
+    expected_output = run_eesi(['--command', 'specs', '--bitcode', changed_file] + config)
+    shutil.rmtree(state_dir)
+
+    if process.returncode != 0:
+        print("{} WARMSTART FAIL. --verify-warmstart exited with {}".format(test_dir, process.returncode))
+        print(error_output)
+        return False
+    if (actual_output != expected_output):
+        print("{} WARMSTART FAIL. Expected/Actual:".format(test_dir))
+        print('\n'.join(difflib.ndiff([expected_output], [actual_output])))
+        return False
+
+    return True
+
+# The specs and bugs with --jobs 4 must equal those with --jobs 1, byte for
+# byte. specs runs ReturnPropagation, ReturnConstraints and ReturnedValues on
+# worker threads for the functions relevant to specs, summary for every
+# function.
+def test_errspec_jobs(test_dir):
+    test_file = test_dir + "/test.bc"
+    config = ['--erroronly', 'test-erroronly.txt', '--inputspecs', 'test-specs.txt']
+    runs = [['--command', 'specs', '--bitcode', test_file] + config,
+            ['--command', 'errorpropagation', '--bitcode', test_file] + config,
+            ['--command', 'summary', '--bitcode', test_file] + config]
+    # MissingChecks checks call sites concurrently and merges them in module
+    # order
+    specs_file = test_dir + "/specs.txt"
+    if os.path.isfile(specs_file):
+        runs.append(['--command', 'bugs', '--bitcode', test_file, '--specs', specs_file, '--erroronly', 'test-erroronly.txt'])
+
+    passed = True
+    for args in runs:
+        expected_output = run_eesi(args + ['--jobs', '1'])
+        actual_output = run_eesi(args + ['--jobs', '4'])
+        if (actual_output != expected_output):
+            print("{} {} JOBS FAIL. Expected/Actual:".format(test_dir, args[1]))
+            print('\n'.join(difflib.ndiff([expected_output], [actual_output])))
+            passed = False
+
+    return passed
+
+# The specs linked from the module's summaries must equal the specs inferred
+# from the whole module
+def test_errspec_summaries(test_dir):
+    test_file = test_dir + "/test.bc"
+    config = ['--erroronly', 'test-erroronly.txt', '--inputspecs', 'test-specs.txt']
+    expected_output = run_eesi(['--command', 'specs', '--bitcode', test_file] + config)
+
+    summary_dir = tempfile.mkdtemp()
+    summary_file = summary_dir + "/summary.txt"
+    run_eesi(['--command', 'summary', '--bitcode', test_file, '--output', summary_file] + config)
+    actual_output = run_eesi(['--command', 'specs', '--summaries', summary_file, '--inputspecs', 'test-specs.txt'])
+    shutil.rmtree(summary_dir)
+
+    if (actual_output != expected_output):
+        print("{} SUMMARIES FAIL. Expected/Actual:".format(test_dir))
+        print('\n'.join(difflib.ndiff([expected_output], [actual_output])))
+        return False
+
+    return True
+
+# The rows of the bugs view and of error_only_reports written by errdb must be
+# the lines that bugs prints with the same inferred specs
+def test_errspec_errdb(test_dir):
+    test_file = test_dir + "/test.bc"
+    config = ['--erroronly', 'test-erroronly.txt', '--inputspecs', 'test-specs.txt']
+
+    db_dir = tempfile.mkdtemp()
+    db_file = db_dir + "/errdb.sqlite"
+    bugs_file = db_dir + "/bugs.txt"
+    run_eesi(['--command', 'specs,bugs', '--output', db_dir + "/specs.txt," + bugs_file, '--bitcode', test_file] + config)
+    run_eesi(['--command', 'errdb', '--output', db_file, '--bitcode', test_file] + config)
+    if not os.path.isfile(db_file):
+        print("{} ERRDB FAIL. No database written".format(test_dir))
+        shutil.rmtree(db_dir)
+        return False
+    with open(bugs_file, 'r') as bugs:
+        expected_output = sorted(bugs.read().splitlines())
+    db = sqlite3.connect(db_file)
+    rows = db.execute("SELECT location, function, unchecked, checked FROM bugs").fetchall()
+    rows += db.execute("SELECT * FROM error_only_reports").fetchall()
+    db.close()
+    shutil.rmtree(db_dir)
+    actual_output = sorted([" ".join([str(field) for field in row]) for row in rows])
+
+    if (actual_output != expected_output):
+        print("{} ERRDB FAIL. Expected/Actual:".format(test_dir))
+        print('\n'.join(difflib.ndiff(expected_output, actual_output)))
+        return False
+
+    return True
+
+# The bugs checked against a spec snapshot must equal those checked against
+# the same specs as text
+def test_errspec_snapshot(test_dir):
+    test_file = test_dir + "/test.bc"
+    config = ['--erroronly', 'test-erroronly.txt', '--inputspecs', 'test-specs.txt']
+
+    snapshot_dir = tempfile.mkdtemp()
+    text_specs = snapshot_dir + "/specs.txt"
+    binary_specs = snapshot_dir + "/specs.snapshot"
+    run_eesi(['--command', 'specs', '--bitcode', test_file, '--output', text_specs] + config)
+    run_eesi(['--command', 'specs', '--bitcode', test_file, '--output', binary_specs, '--snapshot'] + config)
+    bugs = ['--command', 'bugs', '--bitcode', test_file, '--erroronly', 'test-erroronly.txt']
+    expected_output = run_eesi(bugs + ['--specs', text_specs])
+    actual_output = run_eesi(bugs + ['--specs', binary_specs])
+    shutil.rmtree(snapshot_dir)
+
+    if (actual_output != expected_output):
+        print("{} SNAPSHOT FAIL. Expected/Actual:".format(test_dir))
+        print('\n'.join(difflib.ndiff([expected_output], [actual_output])))
+        return False
+
+    return True
+
+# The models in config/error-models-linux.txt are the built-in default
+def test_errspec_models(test_dir):
+    test_file = test_dir + "/test.bc"
+    runs = [['--command', 'specs', '--bitcode', test_file, '--erroronly', 'test-erroronly.txt', '--inputspecs', 'test-specs.txt']]
+    specs_file = test_dir + "/specs.txt"
+    if os.path.isfile(specs_file):
+        runs.append(['--command', 'bugs', '--bitcode', test_file, '--specs', specs_file, '--erroronly', 'test-erroronly.txt'])
+
+    passed = True
+    for args in runs:
+        expected_output = run_eesi(args)
+        actual_output = run_eesi(args + ['--models', '../../config/error-models-linux.txt'])
+        if (actual_output != expected_output):
+            print("{} {} MODELS FAIL. Expected/Actual:".format(test_dir, args[1]))
+            print('\n'.join(difflib.ndiff([expected_output], [actual_output])))
+            passed = False
+
+    return passed
+
+# The codes in config/error-codes-linux.txt are the built-in default
+def test_errspec_errorcodes(test_dir):
+    test_file = test_dir + "/test.bc"
+    args = ['--command', 'specs', '--bitcode', test_file, '--erroronly', 'test-erroronly.txt', '--inputspecs', 'test-specs.txt']
+    expected_output = run_eesi(args)
+    actual_output = run_eesi(args + ['--errorcodes', '../../config/error-codes-linux.txt'])
+    if (actual_output != expected_output):
+        print("{} ERRORCODES FAIL. Expected/Actual:".format(test_dir))
+        print('\n'.join(difflib.ndiff([expected_output], [actual_output])))
+        return False
+
+    return True
+
+# The bugs with --lazy, which drops the bodies that make no checked calls,
+# must equal those without it
+def test_errspec_lazy(test_dir):
+    test_file = test_dir + "/test.bc"
+    specs_file = test_dir + "/specs.txt"
+    if not os.path.isfile(specs_file):
+        return True
+
+    args = ['--command', 'bugs', '--bitcode', test_file, '--specs', specs_file, '--erroronly', 'test-erroronly.txt']
+    expected_output = run_eesi(args)
+    actual_output = run_eesi(args + ['--lazy'])
+    if (actual_output != expected_output):
+        print("{} LAZY FAIL. Expected/Actual:".format(test_dir))
+        print('\n'.join(difflib.ndiff([expected_output], [actual_output])))
+        return False
+
+    return True
+
+# A directory of the test bitcode files with --jobs 2 must give the output of
+# each file on its own, in name order. An unreadable file in a list is
+# reported and makes the exit status 1.
+def test_errspec_batch():
+    batch_dir = tempfile.mkdtemp()
+    for di in sorted(os.listdir(".")):
+        if os.path.isfile(di + "/test.bc"):
+            shutil.copyfile(di + "/test.bc", batch_dir + "/" + di + ".bc")
+    bitcode_files = [batch_dir + "/" + name for name in sorted(os.listdir(batch_dir))]
+    config = ['--command', 'specs', '--erroronly', 'test-erroronly.txt', '--inputspecs', 'test-specs.txt']
+
+    passed = True
+    expected_output = "".join([run_eesi(config + ['--bitcode', bc]) for bc in bitcode_files])
+    actual_output = run_eesi(config + ['--bitcode-list', batch_dir, '--jobs', '2'])
+    if (actual_output != expected_output):
+        print("BATCH FAIL. Expected/Actual:")
+        print('\n'.join(difflib.ndiff([expected_output], [actual_output])))
+        passed = False
+
+    list_dir = tempfile.mkdtemp()
+    broken_file = list_dir + "/broken.bc"
+    with open(broken_file, 'w') as broken:
+        broken.write("not bitcode\n")
+    list_file = list_dir + "/list.txt"
+    with open(list_file, 'w') as bitcode_list:
+        bitcode_list.write("\n".join(bitcode_files + [broken_file]) + "\n")
+    process = subprocess.Popen(
+        ['../build/eesi', '--bitcode-list', list_file, '--jobs', '2'] + config, \
+        stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    actual_output, error_output = process.communicate()
+    if process.returncode != 1 or broken_file not in error_output:
+        print("BATCH FAIL. Unreadable {} not reported, exit status {}".format(broken_file, process.returncode))
+        print(error_output)
+        passed = False
+    if (actual_output != expected_output):
+        print("BATCH FAIL (unreadable file). Expected/Actual:")
+        print('\n'.join(difflib.ndiff([expected_output], [actual_output])))
+        passed = False
+
+    shutil.rmtree(batch_dir)
+    shutil.rmtree(list_dir)
+    return passed
+
 
 if __name__ == "__main__":
     main()
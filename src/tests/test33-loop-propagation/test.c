@@ -0,0 +1,16 @@
+int mustcheck();
+
+// err holds the result of mustcheck only along the back edge
+int retry() {
+	int err;
+	int tries;
+	for (tries = 0; tries < 3; tries++) {
+		if (tries > 0 && err < 0) {
+			return err;
+		}
+		err = mustcheck();
+	}
+	return 0;
+}
+
+// EXPECTED: retry <0
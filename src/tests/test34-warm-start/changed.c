@@ -0,0 +1,23 @@
+int mustcheck();
+
+// Changed: bar returns 1 on error, which changes the spec of its caller baz
+int bar() {
+	int err = mustcheck();
+	if (err < 0) {
+		return 1;
+	}
+	return 0;
+}
+
+int baz() {
+	int err = bar();
+	if (err < 0) {
+		return err;
+	}
+	return 0;
+}
+
+int other() {
+	mustcheck();
+	return 0;
+}
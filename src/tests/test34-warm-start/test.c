@@ -0,0 +1,22 @@
+int mustcheck();
+
+int bar() {
+	int err = mustcheck();
+	if (err < 0) {
+		return err;
+	}
+	return 0;
+}
+
+int baz() {
+	int err = bar();
+	if (err < 0) {
+		return err;
+	}
+	return 0;
+}
+
+int other() {
+	mustcheck();
+	return 0;
+}
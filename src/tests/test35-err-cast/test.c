@@ -0,0 +1,15 @@
+long mustcheck();
+void *ERR_PTR(long error);
+void *ERR_CAST(const void *ptr);
+
+// The error value of mustcheck is returned through ERR_CAST, which passes
+// its argument through
+void *lookup() {
+	long err = mustcheck();
+	if (err < 0) {
+		return ERR_CAST(ERR_PTR(err));
+	}
+	return 0;
+}
+
+// EXPECTED: lookup <0
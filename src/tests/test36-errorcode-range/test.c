@@ -0,0 +1,10 @@
+// Assumes the error codes -10 to -1, given as a range in error-codes.txt
+
+int dev_open(int flags) {
+	if (flags) {
+		return -5;
+	}
+	return 0;
+}
+
+// EXPECTED: dev_open <0
@@ -0,0 +1,13 @@
+// Assumes the enumerators of dev_error are error codes, given as an enum in
+// error-codes.txt
+
+enum dev_error { DEV_EBUSY = -16, DEV_EIO = -5 };
+
+enum dev_error dev_read(int flags) {
+	if (flags) {
+		return DEV_EIO;
+	}
+	return 0;
+}
+
+// EXPECTED: dev_read <0
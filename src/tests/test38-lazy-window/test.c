@@ -0,0 +1,38 @@
+// The window before the call to EO in check starts in done, three functions
+// up, and ends in check before its own call to mustcheck. pad calls nothing
+// that has a spec, so --lazy drops its body; the window must still not reach
+// the call to mustcheck in done.
+
+int mustcheck();
+void EO();
+
+void done() {
+	mustcheck();
+}
+
+int pad(int x) {
+	x = x * 3 + 1;
+	x = x * 5 + 2;
+	x = x * 7 + 3;
+	x = x * 11 + 4;
+	x = x * 13 + 5;
+	x = x * 17 + 6;
+	x = x * 19 + 7;
+	x = x * 23 + 8;
+	x = x * 29 + 9;
+	x = x * 31 + 10;
+	return x;
+}
+
+// The block that calls EO comes first in the layout but runs after mustcheck
+// succeeded
+void check() {
+	goto first;
+second:
+	EO();
+	return;
+first:
+	if (mustcheck() >= 0) {
+		goto second;
+	}
+}